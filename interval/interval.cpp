@@ -28,11 +28,27 @@
 
 #include <gecode/int.hh>
 #include <math.h>
+#include <algorithm>
 
 using namespace Gecode;
 
 using namespace Gecode::Int;
 
+// How the interval branching splits the domain of a coordinate
+enum IntervalSplit {
+	IS_BINARY,  // First subinterval or the rest of the domain
+	IS_KWAY,    // One alternative per subinterval of the domain
+	IS_ADAPTIVE // k-way, with the subintervals evened out over the domain
+};
+
+// Which coordinate the interval branching splits next
+enum IntervalVarSel {
+	IVS_NONE,      // First one in the given order
+	IVS_WIDTH_MAX, // Largest width first
+	IVS_RATIO_MIN, // Smallest ratio of domain size to width first
+	IVS_AFC_MAX    // Largest accumulated failure count, weighted by width, first
+};
+
 /*
  * Custom brancher for forcing mandatory parts
  *
@@ -41,24 +57,34 @@ class IntervalBrancher : public Brancher {
 protected:
 	// Views for x-coordinates (or y-coordinates)
 	ViewArray<IntView> x;
-	// Width (or height) of rectangles
-	int* w;
-	// Percentage for obligatory part
-	double p;
-	// Cache of first unassigned view
+	// Width (or height) of rectangles (shared between all clones)
+	IntSharedArray w;
+	// Size of the subintervals, computed from the percentage for obligatory part when posting (shared)
+	IntSharedArray l;
+	// Order in which the views are considered, sorted when posting for a static selection (shared)
+	IntSharedArray order;
+	// How the domain is split
+	IntervalSplit split;
+	// How the view to split is selected
+	IntervalVarSel sel;
+	// Cache of first position in order that can still be split
 	mutable int start;
+	// View selected by status for the next choice
+	mutable int pick;
 	// Description
 	class Description : public Choice {
 	public:
 		// Position of view
 		int pos, val;
-		// You might need more information, please add here
+		// Size of the subintervals (0 for a binary split at val)
+		int step;
 
 		/* Initialize description for brancher b, number of
-		 *  alternatives a, position p, and splitPos v.
+		 *  alternatives a, position p, splitPos (or start of the first subinterval) v
+		 *  and subinterval size s.
 		 */
-		Description(const Brancher& b, unsigned int a, int p, int v)
-			: Choice(b, a), pos(p), val(v) {}
+		Description(const Brancher& b, unsigned int a, int p, int v, int s)
+			: Choice(b, a), pos(p), val(v), step(s) {}
 		// Report size occupied
 		virtual size_t size(void) const {
 			return sizeof(Description);
@@ -67,59 +93,100 @@ protected:
 		virtual void archive(Archive& e) const {
 			Choice::archive(e);
 			// You must also archive the additional information
-			e << pos << val;
+			e << alternatives() << pos << val << step;
 		}
 	};
+	// Whether x[i] can still be split into subintervals (once not, it never can again)
+	bool splittable(int i) const {
+		if (x[i].assigned())
+			return false;
+		int domainInterval = x[i].max() - x[i].min() + 1;
+		// A binary split at min+l must leave a value above it (otherwise x <= min+l changes
+		// nothing and the same view is split forever), a k-way split needs at least two subintervals
+		return (split == IS_BINARY) ? (l[i] + 1 < domainInterval) : (l[i] < domainInterval);
+	}
+	// Whether x[i] is preferred over x[j] by a dynamic selection
+	bool better(int i, int j) const {
+		switch (sel) {
+		case IVS_RATIO_MIN:
+			// Compare size(i)/w[i] < size(j)/w[j] without division
+			return static_cast<long long int>(x[i].size()) * w[j] < 
+				static_cast<long long int>(x[j].size()) * w[i];
+		case IVS_AFC_MAX:
+			return x[i].afc() * w[i] > x[j].afc() * w[j];
+		default:
+			return false;
+		}
+	}
 public:
 	// Construct branching
 	IntervalBrancher(Home home,
-		ViewArray<IntView>& x0, int w0[], double p0)
-		: Brancher(home), x(x0), w(w0), p(p0), start(0) {}
+		ViewArray<IntView>& x0, IntSharedArray& w0, IntSharedArray& l0, IntSharedArray& o0,
+		IntervalSplit s0, IntervalVarSel v0)
+		: Brancher(home), x(x0), w(w0), l(l0), order(o0), split(s0), sel(v0), start(0), pick(0) {
+		// The shared arrays must be released when the space is deleted
+		home.notice(*this, AP_DISPOSE);
+	}
 	// Post branching
-	static void post(Home home, ViewArray<IntView>& x, int w[], double p) {
-		(void) new (home) IntervalBrancher(home, x, w, p);
+	static void post(Home home, ViewArray<IntView>& x, IntSharedArray& w, IntSharedArray& l,
+		IntSharedArray& o, IntervalSplit s, IntervalVarSel v) {
+		(void) new (home) IntervalBrancher(home, x, w, l, o, s, v);
 	}
 
 	// Copy constructor used during cloning of b
 	IntervalBrancher(Space& home, IntervalBrancher& b)
-		: Brancher(home, b), p(b.p), start(b.start) {
+		: Brancher(home, b), w(b.w), l(b.l), order(b.order), split(b.split), sel(b.sel),
+		  start(b.start), pick(b.pick) {
 		x.update(home, b.x);
-		w = home.alloc<int>(x.size());
-		for (int i = x.size(); i--; )
-			w[i] = b.w[i];
 	}
 	// Copy brancher
 	virtual Actor* copy(Space& home) {
 		return new (home) IntervalBrancher(home, *this);
 	}
+	// Bytes of the shared arrays, which a clone does not copy
+	size_t shared(void) const {
+		return (w.size() + l.size() + order.size()) * sizeof(int);
+	}
 
 	// Check status of brancher, return true if alternatives left
 	virtual bool status(const Space& home) const {
 
-		for (int i = start; i < x.size(); i++) {
-			if (!x[i].assigned()) {
-				int subIntervalSize = w[i] - floor(p*w[i]);
-				int domainInterval = x[i].max() - x[i].min() + 1;
-				
-				if (subIntervalSize <= domainInterval) {
-					start = i; // Start from here next time, could not branch on any x[j] for j < i
-					return true;
-				}
-			}
-		}
+		// Start from here next time, could not branch on any view before start
+		while ((start < x.size()) && !splittable(order[start]))
+			start++;
+		if (start == x.size())
+			return false;
 
-		return false;
+		pick = order[start];
+		// A static order is sorted already, a dynamic one compares all views that can still be split
+		if ((sel == IVS_RATIO_MIN) || (sel == IVS_AFC_MAX)) {
+			for (int k = start + 1; k < x.size(); k++)
+				if (splittable(order[k]) && better(order[k], pick))
+					pick = order[k];
+		}
+		return true;
 
 	}
 	// Return choice as description
 	virtual const Choice* choice(Space& home) {
 		/* 
 		According to MPG, the choice function of a space must be called directly after status.
-		Therefore, we are assuming that the start variable has just been set and therefore do not loop or check
+		Therefore, we are assuming that the pick variable has just been set and therefore do not loop or check
 		for conditions again. 
 		*/
-		int subIntervalSize = w[start] - floor(p*w[start]);
-		return new Description(*this, 2, start, x[start].min() + subIntervalSize);
+		int s = l[pick];
+		if (split == IS_BINARY)
+			return new Description(*this, 2, pick, x[pick].min() + s, 0);
+
+		// One alternative per subinterval of size s
+		int domainInterval = x[pick].max() - x[pick].min() + 1;
+		int k = (domainInterval + s - 1) / s;
+		if (split == IS_ADAPTIVE) {
+			// Same number of subintervals, but of even size: no small remainder at the end,
+			// and every subinterval leaves at least the required obligatory part
+			s = (domainInterval + k - 1) / k;
+		}
+		return new Description(*this, k, pick, x[pick].min(), s);
 
 		/* NOT NEEDED WHEN USING THE START VARIABLE IMPROVEMENT
 		for (int i = start; i < x.size(); i++) {
@@ -137,11 +204,10 @@ public:
 	}
 	// Construct choice from archive e
 	virtual const Choice* choice(const Space&, Archive& e) {
-		
-
-		int pos, val;
-		e >> pos >> val;
-		return new Description(*this, 2, pos, val);
+		unsigned int a;
+		int pos, val, step;
+		e >> a >> pos >> val >> step;
+		return new Description(*this, a, pos, val, step);
 	}
 	// Perform commit for choice c and alternative a
 	virtual ExecStatus commit(Space& home,
@@ -149,29 +215,54 @@ public:
 		unsigned int a) {
 		const Description& d = static_cast<const Description&>(c);
 		int pos = d.pos; int splitPos = d.val;
-		if (a == 0)
-			return me_failed(x[pos].lq(home, splitPos)) ? ES_FAILED : ES_OK;
-		else
-			return me_failed(x[pos].gr(home, splitPos)) ? ES_FAILED : ES_OK;
+		if (d.step == 0) {
+			if (a == 0)
+				return me_failed(x[pos].lq(home, splitPos)) ? ES_FAILED : ES_OK;
+			else
+				return me_failed(x[pos].gr(home, splitPos)) ? ES_FAILED : ES_OK;
+		}
+		// Subinterval a, the last one also takes the rest of the domain
+		int lo = d.val + static_cast<int>(a) * d.step;
+		if ((a > 0) && me_failed(x[pos].gq(home, lo)))
+			return ES_FAILED;
+		if ((a + 1 < d.alternatives()) && me_failed(x[pos].lq(home, lo + d.step - 1)))
+			return ES_FAILED;
+		return ES_OK;
 	}
 	// Print some information on stream o (used by Gist, from Gecode 4.0.1 on)
 	virtual void print(const Space& home, const Choice& c, unsigned int a,
 		std::ostream& o) const {
 
-		// FILL IN HERE
 		const Description& d = static_cast<const Description&>(c);
 		int pos = d.pos; int splitPos = d.val;
-		if (a == 0)
+		if (d.step > 0) {
+			int lo = d.val + static_cast<int>(a) * d.step;
+			if (a + 1 < d.alternatives())
+				o << "x[" << pos << "] in " << lo << ".." << (lo + d.step - 1);
+			else
+				o << "x[" << pos << "] >= " << lo;
+		}
+		else if (a == 0)
 			o << "x[" << pos << "] <= " << splitPos;
 		else
 			o << "x[" << pos << "] > " << splitPos;
 
 
 	}
+	// Dispose brancher and return its size
+	virtual size_t dispose(Space& home) {
+		home.ignore(*this, AP_DISPOSE);
+		w.~IntSharedArray();
+		l.~IntSharedArray();
+		order.~IntSharedArray();
+		(void) Brancher::dispose(home);
+		return sizeof(*this);
+	}
 };
 
 // This posts the interval branching
-void interval(Home home, const IntVarArgs& x, const IntArgs& w, double p) {
+void interval(Home home, const IntVarArgs& x, const IntArgs& w, double p,
+	IntervalSplit s = IS_BINARY, IntervalVarSel v = IVS_NONE) {
 	// Check whether arguments make sense
 	if (x.size() != w.size())
 		throw ArgumentSizeMismatch("interval");
@@ -179,12 +270,25 @@ void interval(Home home, const IntVarArgs& x, const IntArgs& w, double p) {
 	if (home.failed()) return;
 	// Create an array of integer views
 	ViewArray<IntView> vx(home, x);
-	// Create an array of integers
-	int* wc = static_cast<Space&>(home).alloc<int>(x.size());
+	// Create a shared array of integers, clones only copy the reference
+	IntSharedArray wc(w);
+	// Size of the subintervals, placing the rectangle anywhere in one leaves at least p*w[i] obligatory
+	IntArgs l(x.size());
+	for (int i = x.size(); i--; )
+		l[i] = std::max(1, static_cast<int>(w[i] - floor(p*w[i])));
+	IntSharedArray lc(l);
+	// Order in which the views are considered, the largest width first is a static order
+	IntArgs o(x.size());
 	for (int i = x.size(); i--; )
-		wc[i] = w[i];
+		o[i] = i;
+	if (v == IVS_WIDTH_MAX) {
+		for (int i = 1; i < x.size(); i++)
+			for (int k = i; (k > 0) && (w[o[k-1]] < w[o[k]]); k--)
+				std::swap(o[k-1], o[k]);
+	}
+	IntSharedArray oc(o);
 	// Post the brancher
-	IntervalBrancher::post(home, vx, wc, p);
+	IntervalBrancher::post(home, vx, wc, lc, oc, s, v);
 }
 
 
@@ -195,6 +299,8 @@ void interval(Home home, const IntVarArgs& x, const IntArgs& w, double p) {
 *		Nicolas Jeitziner, <njei@kth.se>
 *
 *	We split the interval into two subintervals instead of several. 
+*	IS_KWAY and IS_ADAPTIVE split it into all subintervals at once, the number of alternatives is
+*	the domain width divided by the subinterval size, so that every alternative has an obligatory part.
 *
 */
 
@@ -0,0 +1,67 @@
+/*
+ * Test for the interval branching: on small domains every split mode and
+ * view selection must terminate, and together with a value branching
+ * afterwards find every assignment exactly once (the coordinates are not
+ * constrained, so there are d^n solutions for n coordinates with d values).
+ *
+ * Build like the models, against gecodesearch, gecodeint, gecodekernel and
+ * gecodesupport. Returns 0 if all cases pass.
+ */
+
+#include <gecode/search.hh>
+#include <iostream>
+
+#include "interval.cpp"
+
+class Coordinates : public Space {
+public:
+	IntVarArray x;
+	Coordinates(int d, const IntArgs& w, double p, IntervalSplit s, IntervalVarSel v)
+		: x(*this, w.size(), 0, d - 1) {
+		interval(*this, x, w, p, s, v);
+		branch(*this, x, INT_VAR_NONE(), INT_VAL_MIN());
+	}
+	Coordinates(Coordinates& c) : Space(c) {
+		x.update(*this, c.x);
+	}
+	virtual Space* copy(void) {
+		return new Coordinates(*this);
+	}
+};
+
+int main(void) {
+	const IntArgs w({1, 2, 3});
+	const double ps[] = {0.0, 0.3, 0.5, 1.0};
+	const IntervalSplit splits[] = {IS_BINARY, IS_KWAY, IS_ADAPTIVE};
+	const IntervalVarSel sels[] = {IVS_NONE, IVS_WIDTH_MAX, IVS_RATIO_MIN, IVS_AFC_MAX};
+	int failed = 0;
+	for (int d = 1; d <= 6; d++) {
+		unsigned long int expected = 1;
+		for (int i = 0; i < w.size(); i++)
+			expected *= d;
+		for (int a = 0; a < 4; a++) {
+			for (int b = 0; b < 3; b++) {
+				for (int c = 0; c < 4; c++) {
+					// A branching that never terminates runs into the node limit
+					Search::Options so;
+					so.stop = Search::Stop::node(100000);
+					DFS<Coordinates> e(new Coordinates(d, w, ps[a], splits[b], sels[c]), so);
+					unsigned long int found = 0;
+					while (Coordinates* s = e.next()) {
+						found++;
+						delete s;
+					}
+					if (e.stopped() || (found != expected)) {
+						std::cout << "FAILED: d=" << d << " p=" << ps[a] << " split=" << b << " order=" << c
+							<< ": " << found << " of " << expected << " solutions"
+							<< (e.stopped() ? " (stopped)" : "") << std::endl;
+						failed++;
+					}
+					delete so.stop;
+				}
+			}
+		}
+	}
+	std::cout << (failed == 0 ? "All interval branching tests passed" : "Interval branching tests failed") << std::endl;
+	return (failed == 0) ? 0 : 1;
+}
@@ -8,22 +8,115 @@
 #include <gecode/int.hh>
 #include <gecode/minimodel.hh>
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "stillLife.cpp"
+
 using namespace Gecode;
 
+class LifeOptions : public SizeOptions {
+protected:
+	Driver::BoolOption _parallel; // Whether to run the parallel branch and bound
+	Driver::BoolOption _symmetry; // Whether to break the symmetries of the board
+public:
+	LifeOptions(const char* s) : SizeOptions(s),
+		_parallel("parallel", "parallel branch and bound with work stealing on -threads workers (0 for all cores)", false),
+		_symmetry("symmetry", "break the 8 symmetries of the board (rotations and reflections)", true) {
+		add(_parallel);
+		add(_symmetry);
+	}
+	bool parallel(void) const {
+		return _parallel.value();
+	}
+	bool symmetry(void) const {
+		return _symmetry.value();
+	}
+};
+
 class Life : public IntMaximizeScript {
 public:
+	const int N; // Size of the board (-size)
+	const int NB; // Size with the border of two dead cells on every side
+	const int totalAmountOfCells;
+	const int amountOfSubGrids;
+	static const int cellsInSubGrid = 9;
+
 	IntVarArray cells;
 	IntVarArray subgridDensities;
 	IntVar singleDensity;
 	IntVar aliveCells;
 
-	static const int N = 9;
-	static const int NB = N + 4;
-	static const int totalAmountOfCells = N * N;
-	static const int amountOfSubGrids = (N / 3) * (N / 3);
-	static const int cellsInSubGrid = 9;
+	enum {
+		MODEL_DECOMPOSITION, // The rule as a Boolean expression per cell
+		MODEL_REGULAR, // The rule as a DFA per band of three rows
+		MODEL_PROPAGATOR // The rule as one propagator for the whole grid (stillLife.cpp)
+	};
+
+	/*
+	 * The still-life rule for the middle row of a band of three rows, read column by column.
+	 * A column of the band is a symbol 0-7 (bit 0 top, bit 1 middle, bit 2 bottom). The state
+	 * remembers the last two columns, so the symbol after them decides whether the middle
+	 * cell of the column before is alive with 2 or 3 neighbours or dead without exactly 3.
+	 * States: 0 start, 1-8 one column read, 9-72 two columns read. The DFA does not depend on
+	 * the board, it is built once and shared by all bands and all clones.
+	 */
+	static DFA rule(void) {
+		static const DFA d = buildRule();
+		return d;
+	}
+	static DFA buildRule(void) {
+		std::vector<DFA::Transition> t;
+		for (int s = 0; s < 8; s++) {
+			DFA::Transition first = {0, s, 1 + s};
+			t.push_back(first);
+			for (int n = 0; n < 8; n++) {
+				DFA::Transition second = {1 + s, n, 9 + s * 8 + n};
+				t.push_back(second);
+			}
+		}
+		for (int p = 0; p < 8; p++) {
+			for (int q = 0; q < 8; q++) {
+				for (int n = 0; n < 8; n++) {
+					int alive = (q >> 1) & 1;
+					int neighbours = bits(p) + bits(q) + bits(n) - alive;
+					if (alive ? ((neighbours == 2) || (neighbours == 3)) : (neighbours != 3)) {
+						DFA::Transition next = {9 + p * 8 + q, n, 9 + q * 8 + n};
+						t.push_back(next);
+					}
+				}
+			}
+		}
+		DFA::Transition end = {-1, 0, 0};
+		t.push_back(end);
+		std::vector<int> f;
+		for (int s = 0; s < 73; s++)
+			f.push_back(s);
+		f.push_back(-1);
+		return DFA(0, &t[0], &f[0]);
+	}
+	// The column of a band as a symbol: the table of (top, middle, bottom, symbol)
+	static TupleSet column(void) {
+		static const TupleSet ts = buildColumn();
+		return ts;
+	}
+	static TupleSet buildColumn(void) {
+		TupleSet ts(4);
+		for (int v = 0; v < 8; v++)
+			ts.add(IntArgs({v & 1, (v >> 1) & 1, (v >> 2) & 1, v}));
+		ts.finalize();
+		return ts;
+	}
+	static int bits(int v) {
+		return (v & 1) + ((v >> 1) & 1) + ((v >> 2) & 1);
+	}
 
-	Life(const Options& opt) : IntMaximizeScript(opt),
+	Life(const LifeOptions& opt) : IntMaximizeScript(opt),
+		N(static_cast<int>(opt.size())), NB(N + 4), totalAmountOfCells(N * N), amountOfSubGrids((N / 3) * (N / 3)),
 		cells(*this, NB*NB, 0, 1),
 		subgridDensities(*this, amountOfSubGrids, 0, 6),
 		singleDensity(*this, 0, totalAmountOfCells - (amountOfSubGrids * cellsInSubGrid)),
@@ -43,18 +136,32 @@ public:
 		rel(*this, sum(mat.row(NB - 2)) == 0);
 
 
-		// Neighbour constraints, inner boarder and within
-		for (int i = 1; i < NB - 1; i++) {
+		if (opt.model() == MODEL_PROPAGATOR) {
+			stillLife(*this, cells);
+		} else if (opt.model() == MODEL_REGULAR) {
+			// Every band of three rows reads as a word of column symbols that the rule accepts
 			for (int j = 1; j < NB - 1; j++) {
-				BoolVar b(*this, 0, 1);
-				rel(*this, mat(i, j), IRT_EQ, 1, b);
-
-				rel(*this,
-					(b &&
-					(sum(mat.slice(i - 1, i + 2, j - 1, j + 2)) == 3 || sum(mat.slice(i - 1, i + 2, j - 1, j + 2)) == 4))
-					||
-					(!b && sum(mat.slice(i - 1, i + 2, j - 1, j + 2)) != 3)
-				);
+				IntVarArgs band(NB);
+				for (int i = 0; i < NB; i++) {
+					band[i] = IntVar(*this, 0, 7);
+					extensional(*this, IntVarArgs({mat(i, j - 1), mat(i, j), mat(i, j + 1), band[i]}), column());
+				}
+				extensional(*this, band, rule());
+			}
+		} else {
+			// Neighbour constraints, inner boarder and within
+			for (int i = 1; i < NB - 1; i++) {
+				for (int j = 1; j < NB - 1; j++) {
+					BoolVar b(*this, 0, 1);
+					rel(*this, mat(i, j), IRT_EQ, 1, b);
+
+					rel(*this,
+						(b &&
+						(sum(mat.slice(i - 1, i + 2, j - 1, j + 2)) == 3 || sum(mat.slice(i - 1, i + 2, j - 1, j + 2)) == 4))
+						||
+						(!b && sum(mat.slice(i - 1, i + 2, j - 1, j + 2)) != 3)
+					);
+				}
 			}
 		}
 
@@ -82,6 +189,9 @@ public:
 		rel(*this, aliveCells == sum(subgridDensities) + singleDensity);
 
 
+		if (opt.symmetry())
+			symmetry();
+
 		// First fail
 		branch(*this, cells, INT_VAR_SIZE_MIN(), INT_VAL_MAX());
 		branch(*this, subgridDensities, INT_VAR_SIZE_MIN(), INT_VAL_MAX());
@@ -90,8 +200,39 @@ public:
 
 	}
 
-	Life(Life& s) : IntMaximizeScript(s) {
+	/*
+	 * Break the symmetries of the board: a still life rotated or reflected is a still life
+	 * with the same number of alive cells. The board, row by row, must be lexicographically
+	 * at least each of its 7 images, which leaves one board of every class (the largest, so
+	 * the first one that branching on alive cells first reaches). The images only permute the
+	 * cells, so no further variables are needed.
+	 */
+	void symmetry(void) {
+		Matrix<IntVarArray> mat(cells, NB);
+		IntVarArgs board(N * N), img[7];
+		for (int k = 0; k < 7; k++)
+			img[k] = IntVarArgs(N * N);
+		for (int r = 0; r < N; r++) {
+			for (int c = 0; c < N; c++) {
+				int m = N - 1;
+				board[r * N + c] = mat(2 + c, 2 + r);
+				img[0][r * N + c] = mat(2 + m - c, 2 + r); // Columns mirrored
+				img[1][r * N + c] = mat(2 + c, 2 + m - r); // Rows mirrored
+				img[2][r * N + c] = mat(2 + m - c, 2 + m - r); // Rotation by 180 degrees
+				img[3][r * N + c] = mat(2 + r, 2 + c); // Main diagonal
+				img[4][r * N + c] = mat(2 + m - r, 2 + m - c); // Anti-diagonal
+				img[5][r * N + c] = mat(2 + r, 2 + m - c); // Rotation by 90 degrees
+				img[6][r * N + c] = mat(2 + m - r, 2 + c); // Rotation by 270 degrees
+			}
+		}
+		for (int k = 0; k < 7; k++)
+			rel(*this, board, IRT_GQ, img[k]);
+	}
+
+	Life(Life& s) : IntMaximizeScript(s), N(s.N), NB(s.NB), totalAmountOfCells(s.totalAmountOfCells), amountOfSubGrids(s.amountOfSubGrids) {
 		cells.update(*this, s.cells);
+		subgridDensities.update(*this, s.subgridDensities);
+		singleDensity.update(*this, s.singleDensity);
 		aliveCells.update(*this, s.aliveCells);
 	}
 
@@ -118,11 +259,205 @@ public:
 
 };
 
+/*
+ * Parallel branch and bound. Every worker explores the nodes of its own deque depth first
+ * (newest node first), and a worker without nodes steals the oldest node of another worker,
+ * which is the root of the largest subtree left there. A node is a space that owns its
+ * clone, so spaces never move between threads while in use. The best number of alive cells
+ * is shared by all workers as an atomic: it is raised with compare and exchange whenever a
+ * worker finds a better solution, and every node is constrained to beat it right before it
+ * is propagated, so all workers prune with a new bound from their next node on. The limits
+ * -time, -node and -fail are checked against the nodes and failures of all workers before
+ * every node, and -solutions bounds the number of improving solutions, as with the driver.
+ */
+class ParallelBAB {
+public:
+	const LifeOptions& opt;
+	class Worker {
+	public:
+		std::mutex m;
+		std::deque<Life*> nodes;
+		unsigned long int node, fail, steals;
+		Worker(void) : node(0), fail(0), steals(0) {}
+	};
+	std::vector<Worker*> workers;
+	std::atomic<int> best; // Most alive cells found so far, -1 for none
+	std::atomic<long int> pending; // Nodes in the deques or being explored
+	std::atomic<unsigned long int> node, fail; // Nodes and failures of all workers
+	std::atomic<bool> halt; // Whether the workers must stop, with nodes left or not
+	std::atomic<bool> stopped; // Whether a limit (-time, -node or -fail) stopped the search
+	Search::Options so; // Holds the limits as stop object
+	std::mutex m;
+	Life* solution; // The best solution
+	unsigned int improvements;
+
+	ParallelBAB(const LifeOptions& o)
+		: opt(o), best(-1), pending(0), node(0), fail(0), halt(false), stopped(false), solution(NULL), improvements(0) {
+		so.threads = opt.threads();
+		so.stop = Driver::CombinedStop::create(opt.node(), opt.fail(), opt.time(), false);
+	}
+
+	~ParallelBAB(void) {
+		for (size_t i = 0; i < workers.size(); i++) {
+			for (size_t j = 0; j < workers[i]->nodes.size(); j++)
+				delete workers[i]->nodes[j];
+			delete workers[i];
+		}
+		delete solution;
+		delete so.stop;
+	}
+
+	// The newest node of worker w, or the oldest node of another worker, NULL if there is none
+	Life* take(unsigned int w) {
+		{
+			std::lock_guard<std::mutex> l(workers[w]->m);
+			if (!workers[w]->nodes.empty()) {
+				Life* s = workers[w]->nodes.back();
+				workers[w]->nodes.pop_back();
+				return s;
+			}
+		}
+		for (size_t k = 1; k < workers.size(); k++) {
+			Worker& v = *workers[(w + k) % workers.size()];
+			std::lock_guard<std::mutex> l(v.m);
+			if (!v.nodes.empty()) {
+				Life* s = v.nodes.front();
+				v.nodes.pop_front();
+				workers[w]->steals++;
+				return s;
+			}
+		}
+		return NULL;
+	}
+
+	// A solution with c alive cells, kept if it is the best so far
+	void improve(Life* s, int c) {
+		int b = best.load();
+		while ((c > b) && !best.compare_exchange_weak(b, c))
+			;
+		std::lock_guard<std::mutex> l(m);
+		if ((solution == NULL) || (c > solution->aliveCells.val())) {
+			delete solution;
+			solution = s;
+			improvements++;
+			if (improvements == opt.solutions())
+				halt = true;
+		} else {
+			delete s;
+		}
+	}
+
+	// Whether a limit is reached by the nodes and failures of all workers
+	bool limit(void) {
+		if (so.stop == NULL)
+			return false;
+		Search::Statistics stat;
+		stat.node = node.load();
+		stat.fail = fail.load();
+		return so.stop->stop(stat, so);
+	}
+
+	// Explore nodes until no worker has any left or the search is stopped
+	void work(unsigned int w) {
+		Worker& me = *workers[w];
+		while ((pending.load() > 0) && !halt.load()) {
+			if (limit()) {
+				stopped = true;
+				halt = true;
+				break;
+			}
+			Life* s = take(w);
+			if (s == NULL) {
+				std::this_thread::yield();
+				continue;
+			}
+			me.node++; node++;
+			// Only better solutions than the best one of any worker are of interest
+			int b = best.load();
+			if (b >= 0)
+				rel(*s, s->aliveCells, IRT_GR, b);
+			switch (s->status()) {
+			case SS_FAILED:
+				me.fail++; fail++;
+				delete s;
+				break;
+			case SS_SOLVED:
+				improve(s, s->aliveCells.val());
+				break;
+			case SS_BRANCH: {
+				const Choice* ch = s->choice();
+				unsigned int a = ch->alternatives();
+				std::vector<Life*> children(a);
+				for (unsigned int i = 0; i + 1 < a; i++)
+					children[i] = static_cast<Life*>(s->clone());
+				children[a - 1] = s;
+				for (unsigned int i = 0; i < a; i++)
+					children[i]->commit(*ch, i);
+				delete ch;
+				pending += a;
+				std::lock_guard<std::mutex> l(me.m);
+				// The first alternative is explored first
+				for (unsigned int i = a; i--; )
+					me.nodes.push_back(children[i]);
+				break;
+			}
+			}
+			pending--;
+		}
+	}
+
+	// Run the workers and print the result
+	void run(void) {
+		// As many workers as the driver would use threads (fractions and negative values are relative to the cores)
+		unsigned int n_workers = std::max(static_cast<unsigned int>(so.expand().threads), 1U);
+		Support::Timer t;
+		t.start();
+		for (unsigned int i = 0; i < n_workers; i++)
+			workers.push_back(new Worker());
+		workers[0]->nodes.push_back(new Life(opt));
+		pending = 1;
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < n_workers; i++)
+			threads.push_back(std::thread(&ParallelBAB::work, this, i));
+		for (unsigned int i = 0; i < n_workers; i++)
+			threads[i].join();
+		double time = t.stop();
+		unsigned long int steals = 0;
+		for (unsigned int i = 0; i < n_workers; i++)
+			steals += workers[i]->steals;
+		if (solution != NULL)
+			solution->print(std::cout);
+		else
+			std::cout << "No solution" << std::endl;
+		if (stopped)
+			std::cout << std::endl << "Search engine stopped..." << std::endl;
+		std::cout << std::endl << "Summary" << std::endl
+			<< "\truntime:      " << time << " ms" << std::endl
+			<< "\tworkers:      " << n_workers << std::endl
+			<< "\tsolutions:    " << improvements << " improving" << std::endl
+			<< "\tnodes:        " << node.load() << std::endl
+			<< "\tfailures:     " << fail.load() << std::endl
+			<< "\tsteals:       " << steals << std::endl;
+	}
+};
+
 int main(int argc, char* argv[]) {
 	try {
-		Options opt("Life");
+		LifeOptions opt("Life");
+		opt.size(9);
+		// Branch and bound runs to the best solution unless -solutions says otherwise
+		opt.solutions(0);
+		opt.model(Life::MODEL_REGULAR);
+		opt.model(Life::MODEL_DECOMPOSITION, "decomposition", "Boolean expression of sums per cell");
+		opt.model(Life::MODEL_REGULAR, "regular", "DFA per band of three rows");
+		opt.model(Life::MODEL_PROPAGATOR, "propagator", "one still-life propagator over the grid");
 		opt.parse(argc, argv);
-		Script::run<Life, BAB, Options>(opt);
+		if (opt.parallel()) {
+			ParallelBAB p(opt);
+			p.run();
+		} else {
+			Script::run<Life, BAB, LifeOptions>(opt);
+		}
 	}
 	catch (Exception e) {
 		std::cerr << "Gecode exception: " << e.what() << std::endl;
@@ -184,4 +519,48 @@ int main(int argc, char* argv[]) {
 	no - goods : 0
 	peak depth : 49
 
-	*/
\ No newline at end of file
+	*/
+
+/* Model -model regular (the default):
+
+	The rule is posted per band of three rows instead of per cell. Each column of a band is
+	channeled into a symbol 0-7 by a table of 8 tuples, and the symbols of the band must be
+	accepted by a DFA (Life::rule) that checks the middle cell of every column from the two
+	columns around it. The regular propagator is domain consistent for the whole band, which
+	a sum per cell is not, with NB-2 regular and (NB-2)*NB small table propagators instead of
+	a reified expression per cell. The DFA and the table are built once per process (73
+	states, well under a millisecond) and shared by all clones, so there is nothing to gain
+	from keeping them on disk.
+	-model decomposition keeps the original model.
+*/
+
+/* Board size and symmetries:
+
+	The size of the board is -size (9 by default) instead of a constant. Every still life has up
+	to 8 symmetric copies (rotations and reflections) with the same number of alive cells, which
+	branch and bound would otherwise all have to refute. With -symmetry (the default) the board
+	must be lexicographically at least each of its images, so only one of every class is left.
+	-symmetry false searches all of them as before. For N=10-12 combine it with -model propagator
+	or -model regular and -parallel.
+*/
+
+/* Parallel branch and bound (-parallel -threads 0):
+
+	Each worker keeps its open nodes in a deque and explores them depth first. Idle workers
+	steal the oldest node of another worker, the root of the largest open subtree. The best
+	number of alive cells is an atomic shared by all workers, and every node is constrained
+	to beat it just before propagation, so an improvement prunes on all workers at once.
+	The copy constructor now updates subgridDensities and singleDensity as well, so clones
+	are complete spaces. -time, -node and -fail stop all workers (counted over all of them),
+	-solutions N stops after N improving solutions, and -threads is read like the driver does
+	(0 for all cores, 0.5 for half of them, -1 for all but one).
+*/
+
+/* Model -model propagator:
+
+	A single propagator (stillLife.cpp) checks the rule for the whole grid. It keeps the known
+	cells as an alive and a dead bitplane, and looks up every 3x3 window (as its known and alive
+	cells) in a table built once from the 512 configurations, which says what the unknown cells
+	of the window can still be. Only the windows around cells that got a value are checked again,
+	and a clone only copies the two planes (2*NB words).
+*/
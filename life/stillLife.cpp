@@ -0,0 +1,243 @@
+/*
+ * Still-life propagator for Game of Life: every cell with a complete
+ * 3x3 window on the board is alive with two or three alive neighbours,
+ * or dead without exactly three.
+ *
+ * The known cells are kept as two bitplanes (alive and dead), one word
+ * per row. A window is read from the planes as two 9 bit masks (known
+ * cells and alive cells) and looked up in a table, computed once from
+ * the 512 configurations of a window, that tells which of the unknown
+ * cells can still be dead and which alive. Only the windows around
+ * cells that got a value since they were last checked are looked at
+ * again.
+ *
+ * As with no-overlap.cpp, include (or paste) this file into your model.
+ */
+
+#include <gecode/int.hh>
+
+using namespace Gecode;
+using namespace Gecode::Int;
+
+// The still-life propagator
+class StillLife : public Propagator {
+protected:
+  typedef unsigned long long int Word;
+  // The cells, row by row
+  ViewArray<IntView> x;
+  // The width (and height) of the board, at most 64
+  int n;
+  // The cells known alive and known dead, a word per row
+  Word* alive;
+  Word* dead;
+  // Whether the windows have been checked once
+  bool started;
+
+  // The mask m read as a ternary number (bit i counts 3 to the power i)
+  static int ternary(int m) {
+    int t = 0;
+    for (int i=8, p=6561; i >= 0; i--, p /= 3)
+      if ((m >> i) & 1)
+        t += p;
+    return t;
+  }
+  /*
+   * The table over all windows: the entry of a window with known cells k
+   * and alive cells a (a subset of k) is at ternary(k) + ternary(a). Bits
+   * 0-8 are the unknown cells that can be dead, bits 9-17 those that can
+   * be alive, and bit 18 is set if the window can satisfy the rule at all.
+   * Cell (dr,dc) of the window is bit 3*dr + dc, the middle is bit 4.
+   */
+  class Table {
+  public:
+    int pos[512];
+    int entry[19683];
+    Table(void) {
+      bool rule[512];
+      for (int w=0; w<512; w++) {
+        int s = 0;
+        for (int i=0; i<9; i++)
+          s += (w >> i) & 1;
+        rule[w] = ((w >> 4) & 1) ? ((s == 3) || (s == 4)) : (s != 3);
+        pos[w] = ternary(w);
+      }
+      for (int k=0; k<512; k++)
+        for (int a=k; ; a = (a - 1) & k) {
+          int u = ~k & 511, e = 0;
+          // All completions of the unknown cells
+          for (int c=u; ; c = (c - 1) & u) {
+            int w = a | c;
+            if (rule[w])
+              e |= (1 << 18) | ((~w & u) | ((w & u) << 9));
+            if (c == 0)
+              break;
+          }
+          entry[pos[k] + pos[a]] = e;
+          if (a == 0)
+            break;
+        }
+    }
+  };
+  static const Table& table(void) {
+    static const Table t;
+    return t;
+  }
+
+  // The 3 bits of row r from column c-1 on
+  static int three(const Word* p, int r, int c) {
+    return static_cast<int>((p[r] >> (c - 1)) & 7);
+  }
+  // The middle cells of complete windows in a row
+  Word inner(void) const {
+    return ((Word(1) << (n - 2)) - 1) << 1;
+  }
+  // Mark the windows around cell (r,c) for checking
+  void touch(Word* dirty, int r, int c) const {
+    Word m = ((Word(7) << c) >> 1) & inner();
+    for (int i=r-1; i<=r+1; i++)
+      if ((i >= 1) && (i <= n-2))
+        dirty[i] |= m;
+  }
+  // Record that cell (r,c) has value v
+  void known(Word* dirty, int r, int c, int v) {
+    if (v == 1)
+      alive[r] |= Word(1) << c;
+    else
+      dead[r] |= Word(1) << c;
+    touch(dirty,r,c);
+  }
+public:
+  // Create propagator and initialize
+  StillLife(Home home, ViewArray<IntView>& x0, int n0)
+    : Propagator(home), x(x0), n(n0), started(false) {
+    x.subscribe(home,*this,PC_INT_VAL);
+    alive = home.alloc<Word>(n);
+    dead = home.alloc<Word>(n);
+    for (int i=n; i--; )
+      alive[i] = dead[i] = 0;
+    (void) table();
+  }
+  // Post still-life propagator
+  static ExecStatus post(Home home, ViewArray<IntView>& x, int n) {
+    // Without a complete window there is nothing to check
+    if (n >= 3)
+      (void) new (home) StillLife(home,x,n);
+    return ES_OK;
+  }
+
+  // Copy constructor during cloning
+  StillLife(Space& home, StillLife& p)
+    : Propagator(home,p), n(p.n), started(p.started) {
+    x.update(home,p.x);
+    alive = home.alloc<Word>(n);
+    dead = home.alloc<Word>(n);
+    for (int i=n; i--; ) {
+      alive[i] = p.alive[i]; dead[i] = p.dead[i];
+    }
+  }
+  // Create copy during cloning
+  virtual Propagator* copy(Space& home) {
+    return new (home) StillLife(home,*this);
+  }
+
+  // Re-schedule function after propagator has been re-enabled
+  virtual void reschedule(Space& home) {
+    x.reschedule(home,*this,PC_INT_VAL);
+  }
+
+  // Return cost (the unknown cells are scanned for new values)
+  virtual PropCost cost(const Space&, const ModEventDelta&) const {
+    return PropCost::linear(PropCost::LO,x.size());
+  }
+
+  /*
+   * Perform propagation: record the cells that got a value since the
+   * last propagation and check the windows around them. A window whose
+   * unknown cells can only be dead or only be alive fixes them, which
+   * makes the windows around those cells due again.
+   */
+  virtual ExecStatus propagate(Space& home, const ModEventDelta&) {
+    Region r;
+    const Table& t = table();
+    // Middle cells of the windows to check
+    Word* dirty = r.alloc<Word>(n);
+    for (int i=n; i--; )
+      dirty[i] = 0;
+    if (!started) {
+      for (int i=1; i<n-1; i++)
+        dirty[i] = inner();
+      started = true;
+    }
+    const Word all = (n == 64) ? ~Word(0) : ((Word(1) << n) - 1);
+    for (int i=0; i<n; i++)
+      for (Word u = all & ~(alive[i] | dead[i]); u != 0; u &= u - 1) {
+        int c = 0;
+        while (((u >> c) & 1) == 0)
+          c++;
+        if (x[i*n + c].assigned())
+          known(dirty,i,c,x[i*n + c].val());
+      }
+    for (int i=1; i<n-1; ) {
+      if (dirty[i] == 0) {
+        i++; continue;
+      }
+      int c = 0;
+      while (((dirty[i] >> c) & 1) == 0)
+        c++;
+      dirty[i] &= ~(Word(1) << c);
+      int k = 0, a = 0;
+      for (int d=0; d<3; d++) {
+        k |= (three(alive,i-1+d,c) | three(dead,i-1+d,c)) << (3*d);
+        a |= three(alive,i-1+d,c) << (3*d);
+      }
+      int e = t.entry[t.pos[k] + t.pos[a]];
+      if (e == 0)
+        return ES_FAILED;
+      int u = ~k & 511;
+      // Unknown cells that can not be alive, and those that can not be dead
+      int zero = u & ~(e >> 9), one = u & ~e;
+      for (int b=0; b<9; b++)
+        if (((zero | one) >> b) & 1) {
+          int rr = i - 1 + b/3, cc = c - 1 + b%3;
+          int v = ((one >> b) & 1) ? 1 : 0;
+          GECODE_ME_CHECK(x[rr*n + cc].eq(home,v));
+          known(dirty,rr,cc,v);
+        }
+      // Windows in rows above may be due again
+      if ((zero | one) != 0)
+        i = 1;
+    }
+    for (int i=0; i<n; i++)
+      if ((alive[i] | dead[i]) != all)
+        return ES_FIX;
+    return home.ES_SUBSUMED(*this);
+  }
+
+  // Dispose propagator and return its size
+  virtual size_t dispose(Space& home) {
+    x.cancel(home,*this,PC_INT_VAL);
+    (void) Propagator::dispose(home);
+    return sizeof(*this);
+  }
+};
+
+/*
+ * Post the constraint that the n*n cells x (0 dead, 1 alive) of a board,
+ * row by row, are a still life for every cell with a complete window.
+ * The board can be at most 64 cells wide.
+ */
+void stillLife(Home home, const IntVarArgs& x) {
+  int n = 0;
+  while (n*n < x.size())
+    n++;
+  // Check whether the arguments make sense
+  if ((n*n != x.size()) || (n > 64))
+    throw ArgumentSizeMismatch("stillLife");
+  // Never post a propagator in a failed space
+  if (home.failed()) return;
+  // Set up array of views for the cells
+  ViewArray<IntView> vx(home,x);
+  // If posting failed, fail space
+  if (StillLife::post(home,vx,n) != ES_OK)
+    home.fail();
+}
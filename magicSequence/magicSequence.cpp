@@ -2,13 +2,34 @@
 #include <gecode/int.hh>
 #include <gecode/minimodel.hh>
 
+#include "../runtimes/runtimes.cpp"
+
 using namespace Gecode;
 
 int n;
 
+class MagicOptions : public SizeOptions {
+protected:
+	Driver::UnsignedIntOption _runs; // Number of seeds for the runtime distribution
+public:
+	MagicOptions(const char* s) : SizeOptions(s),
+		_runs("runs", "runtime distribution of the first solution over this many seeds from -seed", 0) {
+		add(_runs);
+	}
+	unsigned int runs(void) const {
+		return _runs.value();
+	}
+};
+
 class MagicSequence : public Script {
 public:
 	IntVarArray seq;
+	enum {
+		BRANCH_FIRSTFAIL,
+		BRANCH_AFC,
+		BRANCH_ACTION,
+		BRANCH_CHB
+	};
 	
 	MagicSequence(const SizeOptions& opt) : Script(opt), seq(*this, opt.size(), 0, opt.size()-1)  {
 		n = opt.size();
@@ -36,7 +57,21 @@ public:
 		linear(*this, c, seq, IRT_EQ, 0);
 
 		// First fail, assignment gives incredible propagation
-		branch(*this, seq, INT_VAR_SIZE_MIN(), INT_VAL_MIN());
+		// The learned orderings break ties at random (from -seed), so that restarts differ
+		switch (opt.branching()) {
+		case BRANCH_FIRSTFAIL:
+			branch(*this, seq, INT_VAR_SIZE_MIN(), INT_VAL_MIN());
+			break;
+		case BRANCH_AFC:
+			branch(*this, seq, tiebreak(INT_VAR_AFC_SIZE_MAX(opt.decay()), INT_VAR_RND(Rnd(opt.seed()))), INT_VAL_MIN());
+			break;
+		case BRANCH_ACTION:
+			branch(*this, seq, tiebreak(INT_VAR_ACTION_SIZE_MAX(opt.decay()), INT_VAR_RND(Rnd(opt.seed()))), INT_VAL_MIN());
+			break;
+		case BRANCH_CHB:
+			branch(*this, seq, tiebreak(INT_VAR_CHB_SIZE_MAX(), INT_VAR_RND(Rnd(opt.seed()))), INT_VAL_MIN());
+			break;
+		}
 	}
 
 	MagicSequence(MagicSequence& s) : Script(s) {
@@ -57,9 +92,19 @@ public:
 };
 
 int main(int argc, char* argv[]) {
-	SizeOptions opt("Magic Sequence");
+	MagicOptions opt("Magic Sequence");
+	opt.branching(MagicSequence::BRANCH_FIRSTFAIL);
+	opt.branching(MagicSequence::BRANCH_FIRSTFAIL, "firstfail", "First fail heuristic");
+	opt.branching(MagicSequence::BRANCH_AFC, "afc", "Largest AFC over size, random ties");
+	opt.branching(MagicSequence::BRANCH_ACTION, "action", "Largest action over size, random ties");
+	opt.branching(MagicSequence::BRANCH_CHB, "chb", "Largest CHB over size, random ties");
 	opt.parse(argc, argv);
-	Script::run<MagicSequence, DFS, SizeOptions>(opt);
+	if (opt.runs() > 0) {
+		runtimes<MagicSequence>(opt);
+		return 0;
+	}
+	// With -restart the driver searches with restarts (RBS) around DFS
+	Script::run<MagicSequence, DFS, MagicOptions>(opt);
 
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,309 @@
+/*
+ * Lines propagator for the matrix model of n-queens: every row and column
+ * of the board holds exactly one queen, every diagonal at most one.
+ *
+ * Every unassigned cell has an advisor. A cell that becomes zero is
+ * closed right in its advisor: it leaves the open-cell bitsets of its
+ * lines, and the open-cell count of its row and column drops. A cell that
+ * becomes one is put on a stack of queens, and a row or column down to at
+ * most one open cell on a stack of lines to check. The propagator then
+ * only works on the two stacks: a queen zeroes the open cells of its four
+ * lines by running over the set bits, and a row or column without queen
+ * with a single open cell gets its queen there. A change of one cell thus
+ * costs the lines through it, not a scan of the board.
+ *
+ * As with no-overlap.cpp, include (or paste) this file into your model.
+ */
+
+#include <gecode/int.hh>
+
+using namespace Gecode;
+using namespace Gecode::Int;
+
+// The lines propagator
+class Lines : public Propagator {
+protected:
+  // Advisor for a single cell
+  class ViewAdvisor : public Advisor {
+  public:
+    // Index of the cell
+    int i;
+    // Create advisor
+    ViewAdvisor(Space& home, Propagator& p,
+                Council<ViewAdvisor>& c, int i0)
+      : Advisor(home,p,c), i(i0) {}
+    // Copy advisor during cloning
+    ViewAdvisor(Space& home, ViewAdvisor& a)
+      : Advisor(home,a), i(a.i) {}
+  };
+  typedef unsigned long long int Word;
+  static const int bits = 64;
+  // The cells, row by row
+  ViewArray<BoolView> x;
+  // The advisors
+  Council<ViewAdvisor> c;
+  // The size of the board
+  int n;
+  // Words per line
+  int w;
+  // Open cells of every line: rows, columns, diagonals, anti-diagonals
+  Word* open;
+  // Open cells of every row (0 to n-1) and column (n to 2n-1)
+  int* count;
+  // State of every row and column: 0 open, 1 has its queen, 2 to check
+  unsigned char* done;
+  // Rows with their queen
+  int n_done;
+  // Stack of cells that became one and are not yet propagated
+  int* queens;
+  int n_queens;
+  // Stack of rows and columns with at most one open cell to check
+  int* check;
+  int n_check;
+
+  // Number of lines
+  int lines(void) const {
+    return 6*n - 2;
+  }
+  // The lines of cell (r,c), the bit of the cell is c for rows, r otherwise
+  int row(int r) const {
+    return r;
+  }
+  int col(int c) const {
+    return n + c;
+  }
+  int diag(int r, int c) const {
+    return 2*n + r - c + n - 1;
+  }
+  int anti(int r, int c) const {
+    return 4*n - 1 + r + c;
+  }
+  // The cell of bit b in line l
+  int cell(int l, int b) const {
+    if (l < n)
+      return l*n + b;
+    if (l < 2*n)
+      return b*n + l - n;
+    if (l < 4*n - 1)
+      return b*n + b - (l - 3*n + 1);
+    return b*n + (l - 4*n + 1) - b;
+  }
+  // Clear bit b of line l
+  void clear(int l, int b) {
+    open[l*w + b/bits] &= ~(Word(1) << (b % bits));
+  }
+  // Close cell (r,c) in all its lines
+  void close(int r, int c) {
+    clear(row(r),c); clear(col(c),r); clear(diag(r,c),r); clear(anti(r,c),r);
+  }
+  // One open cell less in row or column l, which is checked once at most one is left
+  bool less(int l) {
+    if ((--count[l] > 1) || (done[l] != 0))
+      return false;
+    done[l] = 2;
+    check[n_check++] = l;
+    return true;
+  }
+  // Record that cell i has value v, returns whether propagation is needed
+  bool assigned(int i, int v) {
+    if (v == 1) {
+      queens[n_queens++] = i;
+      return true;
+    }
+    int r = i / n, c = i % n;
+    close(r,c);
+    bool l0 = less(row(r));
+    bool l1 = less(col(c));
+    return l0 || l1;
+  }
+  // The position of the lowest bit of v (de Bruijn multiplication)
+  static int lowest(Word v) {
+    static const int index[64] = {
+       0,  1, 48,  2, 57, 49, 28,  3, 61, 58, 50, 42, 38, 29, 17,  4,
+      62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12,  5,
+      63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11,
+      46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19,  9, 13,  8,  7,  6
+    };
+    return index[((v & (~v + 1)) * 0x03f79d71b4cb0a89ULL) >> 58];
+  }
+  // Zero all open cells of line l (their advisors close them)
+  ExecStatus zero(Space& home, int l) {
+    for (int k=0; k<w; k++)
+      for (Word v = open[l*w + k]; v != 0; v &= v - 1) {
+        int i = cell(l, k*bits + lowest(v));
+        GECODE_ME_CHECK(x[i].zero(home));
+      }
+    return ES_OK;
+  }
+public:
+  // Create propagator and initialize
+  Lines(Home home, ViewArray<BoolView>& x0, int n0)
+    : Propagator(home), x(x0), c(home), n(n0), w((n0 + bits - 1) / bits),
+      n_done(0), n_queens(0), n_check(0) {
+    open = home.alloc<Word>(lines()*w);
+    for (int i=lines()*w; i--; )
+      open[i] = 0;
+    for (int r=0; r<n; r++)
+      for (int c=0; c<n; c++) {
+        int b[4][2] = {{row(r),c}, {col(c),r}, {diag(r,c),r}, {anti(r,c),r}};
+        for (int k=0; k<4; k++)
+          open[b[k][0]*w + b[k][1]/bits] |= Word(1) << (b[k][1] % bits);
+      }
+    count = home.alloc<int>(2*n);
+    done = home.alloc<unsigned char>(2*n);
+    for (int i=2*n; i--; ) {
+      count[i] = n; done[i] = 0;
+    }
+    queens = home.alloc<int>(n);
+    check = home.alloc<int>(2*n);
+    // Only unassigned cells need an advisor
+    for (int i=0; i<x.size(); i++)
+      if (x[i].assigned())
+        (void) assigned(i,x[i].one() ? 1 : 0);
+      else
+        x[i].subscribe(home,*new (home) ViewAdvisor(home,*this,c,i));
+    // Lines that start with at most one open cell (only on a 1x1 board)
+    for (int l=0; l<2*n; l++)
+      if ((done[l] == 0) && (count[l] <= 1)) {
+        done[l] = 2;
+        check[n_check++] = l;
+      }
+    if ((n_queens > 0) || (n_check > 0))
+      BoolView::schedule(home,*this,ME_BOOL_VAL);
+  }
+  // Post lines propagator
+  static ExecStatus post(Home home, ViewArray<BoolView>& x, int n) {
+    // More queens than rows can not be placed
+    int q = 0;
+    for (int i=x.size(); i--; )
+      if (x[i].one())
+        q++;
+    if (q > n)
+      return ES_FAILED;
+    (void) new (home) Lines(home,x,n);
+    return ES_OK;
+  }
+
+  // Copy constructor during cloning
+  Lines(Space& home, Lines& p)
+    : Propagator(home,p), n(p.n), w(p.w), n_done(p.n_done),
+      n_queens(p.n_queens), n_check(p.n_check) {
+    x.update(home,p.x);
+    c.update(home,p.c);
+    open = home.alloc<Word>(lines()*w);
+    for (int i=lines()*w; i--; )
+      open[i] = p.open[i];
+    count = home.alloc<int>(2*n);
+    done = home.alloc<unsigned char>(2*n);
+    for (int i=2*n; i--; ) {
+      count[i] = p.count[i]; done[i] = p.done[i];
+    }
+    queens = home.alloc<int>(n);
+    for (int i=n_queens; i--; )
+      queens[i] = p.queens[i];
+    check = home.alloc<int>(2*n);
+    for (int i=n_check; i--; )
+      check[i] = p.check[i];
+  }
+  // Create copy during cloning
+  virtual Propagator* copy(Space& home) {
+    return new (home) Lines(home,*this);
+  }
+
+  // Re-schedule function after propagator has been re-enabled
+  virtual void reschedule(Space& home) {
+    if ((n_queens > 0) || (n_check > 0))
+      BoolView::schedule(home,*this,ME_BOOL_VAL);
+  }
+
+  // Return cost (a queen walks the open cells of its four lines)
+  virtual PropCost cost(const Space&, const ModEventDelta&) const {
+    return PropCost::linear(PropCost::LO,n);
+  }
+
+  // Record cells that became assigned, zeros are closed right away
+  virtual ExecStatus advise(Space& home, Advisor& a0, const Delta&) {
+    ViewAdvisor& a = static_cast<ViewAdvisor&>(a0);
+    int v = x[a.i].one() ? 1 : 0;
+    // More pending queens than rows means two share a row
+    if ((v == 1) && (n_queens == n))
+      return ES_FAILED;
+    if (assigned(a.i,v))
+      return home.ES_NOFIX_DISPOSE(c,a);
+    return home.ES_FIX_DISPOSE(c,a);
+  }
+
+  /*
+   * Perform propagation: zero the lines of every new queen, and place the
+   * queen of every row and column to check with a single open cell left.
+   * The cells assigned here are recorded by their advisors, so the loop
+   * ends when both stacks are empty.
+   */
+  virtual ExecStatus propagate(Space& home, const ModEventDelta&) {
+    while ((n_queens > 0) || (n_check > 0)) {
+      if (n_queens > 0) {
+        int i = queens[--n_queens];
+        int qr = i / n, qc = i % n;
+        // Only one queen per row and column
+        if ((done[row(qr)] == 1) || (done[col(qc)] == 1))
+          return ES_FAILED;
+        done[row(qr)] = done[col(qc)] = 1;
+        n_done++;
+        close(qr,qc);
+        // A second queen in a line is still open and fails here
+        GECODE_ES_CHECK(zero(home,row(qr)));
+        GECODE_ES_CHECK(zero(home,col(qc)));
+        GECODE_ES_CHECK(zero(home,diag(qr,qc)));
+        GECODE_ES_CHECK(zero(home,anti(qr,qc)));
+      } else {
+        // A row or column without queen needs an open cell, one left takes the queen
+        int l = check[--n_check];
+        if (done[l] == 1)
+          continue;
+        done[l] = 0;
+        if (count[l] == 0)
+          return ES_FAILED;
+        int b = 0;
+        for (int k=0; k<w; k++)
+          if (open[l*w + k] != 0) {
+            b = k*bits + lowest(open[l*w + k]);
+            break;
+          }
+        GECODE_ME_CHECK(x[cell(l,b)].one(home));
+      }
+    }
+    // All rows have their queen and all other cells are zero
+    if (n_done == n)
+      return home.ES_SUBSUMED(*this);
+    return ES_FIX;
+  }
+
+  // Dispose propagator and return its size
+  virtual size_t dispose(Space& home) {
+    for (Advisors<ViewAdvisor> as(c); as(); ++as)
+      x[as.advisor().i].cancel(home,as.advisor());
+    c.dispose(home);
+    (void) Propagator::dispose(home);
+    return sizeof(*this);
+  }
+};
+
+/*
+ * Post the constraint that the n*n cells x of a board, row by row, have
+ * exactly one queen (1) per row and column and at most one per diagonal.
+ */
+void lines(Home home, const BoolVarArgs& x) {
+  int n = 0;
+  while (n*n < x.size())
+    n++;
+  // Check whether the arguments make sense
+  if (n*n != x.size())
+    throw ArgumentSizeMismatch("lines");
+  // Never post a propagator in a failed space
+  if (home.failed()) return;
+  // Set up array of views for the cells
+  ViewArray<BoolView> vx(home,x);
+  // If posting failed, fail space
+  if (Lines::post(home,vx,n) != ES_OK)
+    home.fail();
+}
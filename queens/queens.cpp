@@ -39,6 +39,8 @@
 #include <gecode/int.hh>
 #include <gecode/minimodel.hh>
 
+#include "lines.cpp"
+
 #if defined(GECODE_HAS_QT) && defined(GECODE_HAS_GIST)
 #include <QtGui>
 #if QT_VERSION >= 0x050000
@@ -60,12 +62,11 @@ using namespace Gecode;
 class Queens : public Script {
 public:
   /// Position of queens on boards
-  IntVarArray q;
+  BoolVarArray q;
   /// Propagation to use for model
   enum {
-    PROP_BINARY,  ///< Use only binary disequality constraints
-    PROP_MIXED,   ///< Use single distinct and binary disequality constraints
-    PROP_DISTINCT, ///< Use three distinct constraints
+    PROP_LINEAR,  ///< Use linear constraints for every line
+    PROP_LINES,   ///< Use a single propagator for all lines
 	BRANCH_FIRSTFAIL,
 	BRANCH_MIDDLEVALUE,
 	BRANCH_KNIGHTMOVE
@@ -74,28 +75,34 @@ public:
   Queens(const SizeOptions& opt)
 	  : Script(opt), q(*this,opt.size()*opt.size(),0,1) {
 	  int n = opt.size();
-	  Matrix<IntVarArray> mat(q, opt.size());
-	  for (int i = 0; i < n; i++) { // 2n constraints
-		  rel(*this, sum(mat.col(i)) == 1);
-		  rel(*this, sum(mat.row(i)) == 1);
-	  }
-	  
-	  for (int i = 0; i < n - 1; i++) { // 4n constraints
-		  linear(*this, diagonal(i, 0, n, mat), IRT_LQ,  1); // Left edge
-		  linear(*this, diagonal(n-1, i, n, mat), IRT_LQ, 1); // Bottom edge
-		  linear(*this, diagonal(n - 1 - i, n - 1, n, mat), IRT_LQ, 1); // Right edge
-		  linear(*this, diagonal(0, n - 1 - i, n, mat), IRT_LQ, 1); // Top edge
+	  Matrix<BoolVarArray> mat(q, opt.size());
+	  if (opt.propagation() == PROP_LINES) {
+		  // One propagator for all 6n-2 lines
+		  lines(*this, q);
+	  } else {
+		  for (int i = 0; i < n; i++) { // 2n constraints
+			  rel(*this, sum(mat.col(i)) == 1);
+			  rel(*this, sum(mat.row(i)) == 1);
+		  }
+
+		  for (int i = 0; i < n - 1; i++) { // 4n constraints
+			  linear(*this, diagonal(i, 0, n, mat), IRT_LQ,  1); // Left edge
+			  linear(*this, diagonal(n-1, i, n, mat), IRT_LQ, 1); // Bottom edge
+			  linear(*this, diagonal(n - 1 - i, n - 1, n, mat), IRT_LQ, 1); // Right edge
+			  linear(*this, diagonal(0, n - 1 - i, n, mat), IRT_LQ, 1); // Top edge
+		  }
 	  }
-    
+
+	// Cells are 0/1: the smallest domain is any unassigned cell
 	switch (opt.branching()) {
 	case BRANCH_FIRSTFAIL:
-		branch(*this, q, INT_VAR_SIZE_MIN(), INT_VAL_MIN());
+		branch(*this, q, BOOL_VAR_NONE(), BOOL_VAL_MIN());
 		break;
 	case BRANCH_MIDDLEVALUE:
-		branch(*this, q, INT_VAR_SIZE_MIN(), INT_VAL_SPLIT_MAX());
+		branch(*this, q, BOOL_VAR_NONE(), BOOL_VAL_MAX());
 		break;
 	case BRANCH_KNIGHTMOVE:
-		branch(*this, q, INT_VAR_MIN_MIN(), INT_VAL_MIN());
+		branch(*this, q, BOOL_VAR_NONE(), BOOL_VAL_MIN());
 		break;
 	}
   }
@@ -122,10 +129,10 @@ public:
     }
     os << std::endl;
   }
-  IntVarArgs diagonal(int i, int j, int n, Matrix<IntVarArray> mat) { 
-	  IntVarArgs empty;
+  BoolVarArgs diagonal(int i, int j, int n, Matrix<BoolVarArray> mat) {
+	  BoolVarArgs empty;
 	  if (j == 0 && i != n - 1) { // Left edge (can return main diagonal) (assuming (0,0) is top-left corner)
-		  IntVarArgs diag(n - i);
+		  BoolVarArgs diag(n - i);
 		  int s = 0;
 		  while (i <= n-1) { // Moves diagonally to bottom edge
 			  diag[s] = mat(i, j); // x[0] + i
@@ -136,7 +143,7 @@ public:
 		  return diag;
 	  }
 	  else if (i == n - 1 && j != n - 1) { // Bottom edge (can return main diagonal)
-		  IntVarArgs diag(n - j);
+		  BoolVarArgs diag(n - j);
 		  int s = 0;
 		  while (j <= n-1) { // Moves diagonally to right edge
 			  diag[s] = mat(i, j);
@@ -147,7 +154,7 @@ public:
 		  return diag;
 	  }
 	  else if (j == n - 1 && i != 0 && i != n - 1) { // Right edge (cannot not return main diagonal)
-		  IntVarArgs diag(i + 1);
+		  BoolVarArgs diag(i + 1);
 		  int s = 0;
 		  while (i >= 0) { // Moves diagonally to top edge
 			  diag[s] = mat(i, j);
@@ -158,7 +165,7 @@ public:
 		  return diag;
 	  }
 	  else if (i == 0 && j != 0 && j != n - 1) { // Top edge (cannot not return main diagonal)
-		  IntVarArgs diag(j+1);
+		  BoolVarArgs diag(j+1);
 		  int s = 0;
 		  while (j >= 0) { // Moves diagonally to left edge
 			  diag[s] = mat(i, j);
@@ -197,14 +204,19 @@ public:
       delete i;
     }
 
-    for (int i=0; i<q.q.size(); i++) {
-      for (int j=0; j<q.q.size(); j++) {
-        scene->addRect(i*unit,j*unit,unit,unit);
-      }
-      QBrush b(q.q[i].assigned() ? Qt::black : Qt::red);
-      QPen p(q.q[i].assigned() ? Qt::black : Qt::white);
-      for (IntVarValues xv(q.q[i]); xv(); ++xv) {
-        scene->addEllipse(QRectF(i*unit+unit/4,xv.val()*unit+unit/4,
+    // The cells are row by row, a queen may still go where a cell is not 0
+    int n = 0;
+    while (n*n < q.q.size())
+      n++;
+    for (int i=0; i<n; i++) {
+      for (int j=0; j<n; j++) {
+        scene->addRect(j*unit,i*unit,unit,unit);
+        const BoolVar& x = q.q[i*n+j];
+        if (x.max() == 0)
+          continue;
+        QBrush b(x.assigned() ? Qt::black : Qt::red);
+        QPen p(x.assigned() ? Qt::black : Qt::white);
+        scene->addEllipse(QRectF(j*unit+unit/4,i*unit+unit/4,
                                  unit/2,unit/2), p, b);
       }
     }
@@ -246,13 +258,11 @@ main(int argc, char* argv[]) {
   SizeOptions opt("Queens");
   opt.iterations(500);
   opt.size(15);
-  opt.propagation(Queens::PROP_DISTINCT);
-  opt.propagation(Queens::PROP_BINARY, "binary",
-                      "only binary disequality constraints");
-  opt.propagation(Queens::PROP_MIXED, "mixed",
-                      "single distinct and binary disequality constraints");
-  opt.propagation(Queens::PROP_DISTINCT, "distinct",
-                      "three distinct constraints");
+  opt.propagation(Queens::PROP_LINES);
+  opt.propagation(Queens::PROP_LINEAR, "linear",
+                      "linear constraints for every line");
+  opt.propagation(Queens::PROP_LINES, "lines",
+                      "single propagator for all lines");
   opt.branching(Queens::BRANCH_FIRSTFAIL);
   opt.branching(Queens::BRANCH_FIRSTFAIL, "firstfail", "First fail heuristic");
   opt.branching(Queens::BRANCH_MIDDLEVALUE, "middle", "Select middle value");
@@ -297,3 +307,15 @@ main(int argc, char* argv[]) {
 // Complexity:
 // n^2 variables
 // 6n constraints
+
+// Lines propagator (-propagation lines, the default):
+// The cells are Boolean variables and all rows, columns and diagonals
+// are handled by one propagator (lines.cpp) instead of 6n-2 linear
+// ones. It keeps the open cells of every line as a bitset and an
+// advisor per cell: a zero is closed in its advisor, a queen zeroes the
+// rest of its lines by walking the set bits, and a row or column with a
+// single open cell gets its queen. A propagation only touches the lines
+// through the cells that changed, and the state besides the advisors is
+// about 6n*n/64 words instead of 6n linear propagators over n^2 views,
+// which matters at n=100 (10,000 cells).
+// -propagation linear keeps the linear constraints to compare.
@@ -39,6 +39,14 @@
 #include <gecode/int.hh>
 #include <gecode/minimodel.hh>
 
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../runtimes/runtimes.cpp"
+
 #if defined(GECODE_HAS_QT) && defined(GECODE_HAS_GIST)
 #include <QtGui>
 #if QT_VERSION >= 0x050000
@@ -48,6 +56,68 @@
 
 using namespace Gecode;
 
+/// Options for the queens model
+class QueensOptions : public SizeOptions {
+protected:
+  /// Whether to count all solutions
+  Driver::BoolOption _count;
+  /// Whether to break the board symmetries when counting
+  Driver::BoolOption _symmetry;
+  /// Number of rows fixed per counting job
+  Driver::UnsignedIntOption _prefix;
+  /// Whether to solve with local search
+  Driver::BoolOption _local;
+  /// Whether to check the local search solution with the model
+  Driver::BoolOption _check;
+  /// Number of seeds for the runtime distribution
+  Driver::UnsignedIntOption _runs;
+public:
+  /// Initialize options for script with name \a s
+  QueensOptions(const char* s) : SizeOptions(s),
+    _count("count", "count all solutions on -threads cores (0 for all)",
+           false),
+    _symmetry("symmetry", "break the 8 board symmetries when counting",
+              true),
+    _prefix("prefix", "rows fixed per counting job", 2),
+    _local("local", "solve with min-conflicts local search (from -seed)",
+           false),
+    _check("check", "check the local search solution with the model",
+           false),
+    _runs("runs", "runtime distribution of the first solution over this "
+          "many seeds from -seed", 0) {
+    add(_count);
+    add(_symmetry);
+    add(_prefix);
+    add(_local);
+    add(_check);
+    add(_runs);
+  }
+  /// Return whether to count all solutions
+  bool count(void) const {
+    return _count.value();
+  }
+  /// Return whether to break the board symmetries when counting
+  bool symmetry(void) const {
+    return _symmetry.value();
+  }
+  /// Return number of rows fixed per counting job
+  int prefix(void) const {
+    return static_cast<int>(_prefix.value());
+  }
+  /// Return whether to solve with local search
+  bool local(void) const {
+    return _local.value();
+  }
+  /// Return whether to check the local search solution with the model
+  bool check(void) const {
+    return _check.value();
+  }
+  /// Return number of seeds for the runtime distribution
+  unsigned int runs(void) const {
+    return _runs.value();
+  }
+};
+
 /**
  * \brief %Example: n-%Queens puzzle
  *
@@ -68,10 +138,13 @@ public:
     PROP_DISTINCT, ///< Use three distinct constraints
 	BRANCH_FIRSTFAIL,
 	BRANCH_MIDDLEVALUE,
-	BRANCH_KNIGHTMOVE
+	BRANCH_KNIGHTMOVE,
+	BRANCH_AFC,
+	BRANCH_ACTION,
+	BRANCH_CHB
   };
   /// The actual problem
-  Queens(const SizeOptions& opt)
+  Queens(const QueensOptions& opt)
     : Script(opt), q(*this,opt.size(),0,opt.size()-1) {
     const int n = q.size();
     switch (opt.propagation()) {
@@ -97,6 +170,8 @@ public:
       distinct(*this, q, opt.ipl());
       break;
     }
+    if (opt.count() && opt.symmetry())
+      symmetry();
 	switch (opt.branching()) {
 	case BRANCH_FIRSTFAIL:
 		branch(*this, q, INT_VAR_SIZE_MIN(), INT_VAL_MIN());
@@ -107,9 +182,76 @@ public:
 	case BRANCH_KNIGHTMOVE:
 		branch(*this, q, INT_VAR_MIN_MIN(), INT_VAL_MIN());
 		break;
+	// Learned orderings, ties broken at random (from -seed) so that restarts differ
+	case BRANCH_AFC:
+		branch(*this, q, tiebreak(INT_VAR_AFC_SIZE_MAX(opt.decay()), INT_VAR_RND(Rnd(opt.seed()))),
+		       INT_VAL_MIN());
+		break;
+	case BRANCH_ACTION:
+		branch(*this, q, tiebreak(INT_VAR_ACTION_SIZE_MAX(opt.decay()), INT_VAR_RND(Rnd(opt.seed()))),
+		       INT_VAL_MIN());
+		break;
+	case BRANCH_CHB:
+		branch(*this, q, tiebreak(INT_VAR_CHB_SIZE_MAX(), INT_VAR_RND(Rnd(opt.seed()))),
+		       INT_VAL_MIN());
+		break;
 	}
   }
 
+  /**
+   * Break the 8 symmetries of the board (rotations and reflections) by
+   * requiring that the solution is lexicographically at most each of its
+   * 7 images, so every class of symmetric solutions has exactly one
+   * member left, its smallest.
+   */
+  void symmetry(void) {
+    const int n = q.size();
+    // Row of the queen in every column, and both arrays mirrored
+    IntVarArgs r(*this,n,0,n-1), mq(*this,n,0,n-1), mr(*this,n,0,n-1);
+    channel(*this, q, r);
+    for (int i=0; i<n; i++) {
+      rel(*this, mq[i] == n-1-q[i]);
+      rel(*this, mr[i] == n-1-r[i]);
+    }
+    IntVarArgs img[7];
+    for (int k=0; k<7; k++)
+      img[k] = IntVarArgs(n);
+    for (int i=0; i<n; i++) {
+      img[0][i] = mq[i];          // Columns mirrored
+      img[1][i] = q[n-1-i];       // Rows mirrored
+      img[2][i] = mq[n-1-i];      // Rotation by 180 degrees
+      img[3][i] = r[i];           // Main diagonal
+      img[4][i] = mr[n-1-i];      // Anti-diagonal
+      img[5][i] = mr[i];          // Rotation by 90 degrees
+      img[6][i] = r[n-1-i];       // Rotation by 270 degrees
+    }
+    for (int k=0; k<7; k++)
+      rel(*this, q, IRT_LQ, img[k]);
+  }
+
+  /// Number of different solutions among the 8 images of the solution
+  int orbit(void) const {
+    const int n = q.size();
+    std::vector<int> c(n), r(n);
+    for (int i=0; i<n; i++) {
+      c[i] = q[i].val();
+      r[c[i]] = i;
+    }
+    std::vector<std::vector<int> > img(8, std::vector<int>(n));
+    for (int i=0; i<n; i++) {
+      img[0][i] = c[i];
+      img[1][i] = n-1-c[i];
+      img[2][i] = c[n-1-i];
+      img[3][i] = n-1-c[n-1-i];
+      img[4][i] = r[i];
+      img[5][i] = n-1-r[n-1-i];
+      img[6][i] = n-1-r[i];
+      img[7][i] = r[n-1-i];
+    }
+    std::sort(img.begin(), img.end());
+    return static_cast<int>(std::unique(img.begin(), img.end()) - img.begin());
+  }
+
   /// Constructor for cloning \a s
   Queens(Queens& s) : Script(s) {
     q.update(*this, s.q);
@@ -200,12 +342,229 @@ public:
 
 #endif /* GECODE_HAS_GIST */
 
+/*
+ * Count all solutions in parallel. The first -prefix rows are fixed in
+ * every possible way (as far as propagation allows), and each prefix is a
+ * job that counts the solutions below it with a sequential search. The
+ * workers take the jobs one by one, so long and short jobs even out. As
+ * cloning a space updates the original, every worker clones from its own
+ * prototype. Solutions are never printed, only counted, and with symmetry
+ * breaking every solution counts for the size of its class.
+ */
+class Counter {
+public:
+  const QueensOptions& opt;
+  int k; // Rows per prefix
+  std::vector<int> prefixes; // All prefixes, k values each
+  std::atomic<size_t> next; // Next prefix to hand out
+  std::vector<Queens*> prototypes; // Propagated model, one per worker
+  std::atomic<unsigned long long int> solutions, classes, nodes, failures;
+
+  Counter(const QueensOptions& o)
+    : opt(o), k(0), next(0), solutions(0), classes(0), nodes(0),
+      failures(0) {}
+
+  ~Counter(void) {
+    for (size_t i = 0; i < prototypes.size(); i++)
+      delete prototypes[i];
+  }
+
+  // Collect the prefixes that extend s (with rows up to d fixed)
+  void collect(Queens& s, int d, std::vector<int>& p) {
+    if (d == k) {
+      prefixes.insert(prefixes.end(), p.begin(), p.end());
+      return;
+    }
+    for (IntVarValues v(s.q[d]); v(); ++v) {
+      Queens* c = static_cast<Queens*>(s.clone());
+      rel(*c, c->q[d], IRT_EQ, v.val());
+      if (c->status() != SS_FAILED) {
+        p.push_back(v.val());
+        collect(*c, d+1, p);
+        p.pop_back();
+      }
+      delete c;
+    }
+  }
+
+  // Count the solutions of the jobs taken by worker w
+  void work(int w) {
+    const Queens& prototype = *prototypes[w];
+    size_t n_jobs = prefixes.size() / std::max(k,1);
+    for (size_t j = next++; j < n_jobs; j = next++) {
+      Queens* s = static_cast<Queens*>(prototype.clone());
+      for (int i = 0; i < k; i++)
+        rel(*s, s->q[i], IRT_EQ, prefixes[j*k + i]);
+      Search::Options so;
+      so.threads = 1;
+      so.clone = false;
+      DFS<Queens> e(s, so);
+      unsigned long long int n_s = 0, n_c = 0;
+      while (Queens* sol = e.next()) {
+        n_s += opt.symmetry() ? sol->orbit() : 1;
+        n_c++;
+        delete sol;
+      }
+      Search::Statistics stat = e.statistics();
+      solutions += n_s;
+      classes += n_c;
+      nodes += stat.node;
+      failures += stat.fail;
+    }
+  }
+
+  // Count all solutions
+  void run(void) {
+    // As many workers as the driver would use threads (0 for all cores,
+    // fractions and negative values relative to the number of cores)
+    Search::Options so;
+    so.threads = opt.threads();
+    unsigned int n_workers =
+      std::max(static_cast<unsigned int>(so.expand().threads), 1U);
+    Queens* root = new Queens(opt);
+    if (root->status() != SS_FAILED) {
+      k = std::min(opt.prefix(), root->q.size());
+      std::vector<int> p;
+      collect(*root, 0, p);
+      // With no rows fixed there is a single job: the whole board
+      if (k == 0)
+        prefixes.push_back(0);
+    }
+    prototypes.push_back(root);
+    for (unsigned int w = 1; w < n_workers; w++)
+      prototypes.push_back(static_cast<Queens*>(root->clone()));
+    std::vector<std::thread> workers;
+    for (unsigned int w = 0; w < n_workers; w++)
+      workers.push_back(std::thread(&Counter::work, this, w));
+    for (unsigned int w = 0; w < n_workers; w++)
+      workers[w].join();
+  }
+};
+
+/*
+ * Min-conflicts local search for large n. The queens are a permutation
+ * (the column of the queen of every row, as q in the model), so rows and
+ * columns never conflict, and the queens on every diagonal are counted in
+ * flat arrays. The start is a greedy random placement: row by row, a few
+ * random columns among the unused ones are tried for a free diagonal pair,
+ * and the last rows take what is left. The repair then swaps the columns
+ * of a queen under attack with those of a random queen whenever that
+ * lowers the number of attacks.
+ */
+class MinConflicts {
+public:
+  int n;
+  std::vector<int> c; // Column of the queen of every row
+  std::vector<int> d1, d2; // Queens on every diagonal r+c and r-c+n-1
+  unsigned long long int swaps, tries; // Swaps done and tried
+  int restarts;
+protected:
+  std::mt19937 rnd;
+  // Random number in [0,m)
+  int random(int m) {
+    return static_cast<int>((static_cast<unsigned long long int>(rnd()) * m) >> 32);
+  }
+  // Number of other queens attacking the queen in row r
+  int attacks(int r) const {
+    return d1[r + c[r]] + d2[r - c[r] + n - 1] - 2;
+  }
+  void place(int r, int v) {
+    d1[r + c[r]] += v; d2[r - c[r] + n - 1] += v;
+  }
+  // Attacking pairs along diagonals (a diagonal with k queens has k-1 too many)
+  long long int collisions(void) const {
+    long long int s = 0;
+    for (int i = 0; i < 2*n - 1; i++) {
+      if (d1[i] > 1) s += d1[i] - 1;
+      if (d2[i] > 1) s += d2[i] - 1;
+    }
+    return s;
+  }
+  // Change of the collisions when the queens of rows i and j swap columns
+  int swap(int i, int j) {
+    int before = 0, after = 0;
+    // Collisions of a diagonal before and after, counted as the queen is removed or added
+    place(i, -1); before -= (d1[i + c[i]] >= 1) + (d2[i - c[i] + n - 1] >= 1);
+    place(j, -1); before -= (d1[j + c[j]] >= 1) + (d2[j - c[j] + n - 1] >= 1);
+    std::swap(c[i], c[j]);
+    after += (d1[i + c[i]] >= 1) + (d2[i - c[i] + n - 1] >= 1); place(i, 1);
+    after += (d1[j + c[j]] >= 1) + (d2[j - c[j] + n - 1] >= 1); place(j, 1);
+    return after + before;
+  }
+  // Greedy random placement, the last free rows take any column
+  void start(void) {
+    for (int i = 0; i < n; i++)
+      c[i] = i;
+    std::fill(d1.begin(), d1.end(), 0);
+    std::fill(d2.begin(), d2.end(), 0);
+    const int tries = 4 * n;
+    int i = 0;
+    for (int t = 0; (i < n) && (t < tries); t++) {
+      int j = i + random(n - i);
+      std::swap(c[i], c[j]);
+      if ((d1[i + c[i]] == 0) && (d2[i - c[i] + n - 1] == 0)) {
+        place(i, 1);
+        i++;
+      } else {
+        std::swap(c[i], c[j]);
+      }
+    }
+    for (; i < n; i++) {
+      std::swap(c[i], c[i + random(n - i)]);
+      place(i, 1);
+    }
+  }
+public:
+  MinConflicts(int n0, unsigned int seed)
+    : n(n0), c(n0), d1(2*n0 - 1), d2(2*n0 - 1), swaps(0), tries(0),
+      restarts(0), rnd(seed) {}
+
+  // Search for a solution, giving up after max sweeps without a solution
+  bool solve(int max) {
+    if ((n == 2) || (n == 3))
+      return false;
+    for (int s = 0; s < max; s++) {
+      if (s % 32 == 0) {
+        if (s > 0)
+          restarts++;
+        start();
+      }
+      long long int k = collisions();
+      if (k == 0)
+        return true;
+      std::vector<int> attacked;
+      for (int i = 0; i < n; i++)
+        if (attacks(i) > 0)
+          attacked.push_back(i);
+      for (size_t a = 0; (a < attacked.size()) && (k > 0); a++) {
+        int i = attacked[a];
+        // Swap with random queens until the attacks go down
+        for (int t = 0; (t < 8 * n) && (attacks(i) > 0); t++) {
+          int j = random(n);
+          if (j == i)
+            continue;
+          tries++;
+          int delta = swap(i, j);
+          if (delta < 0) {
+            k += delta; swaps++;
+          } else {
+            (void) swap(i, j);
+          }
+        }
+      }
+      if (k == 0)
+        return true;
+    }
+    return false;
+  }
+};
+
 /** \brief Main-function
  *  \relates Queens
  */
 int
 main(int argc, char* argv[]) {
-  SizeOptions opt("Queens");
+  QueensOptions opt("Queens");
   opt.iterations(500);
   opt.size(100);
   opt.propagation(Queens::PROP_DISTINCT);
@@ -219,6 +578,9 @@ main(int argc, char* argv[]) {
   opt.branching(Queens::BRANCH_FIRSTFAIL, "firstfail", "First fail heuristic");
   opt.branching(Queens::BRANCH_MIDDLEVALUE, "middle", "Select middle value");
   opt.branching(Queens::BRANCH_KNIGHTMOVE, "knight", "Select variable with smallest min value");
+  opt.branching(Queens::BRANCH_AFC, "afc", "Largest AFC over size, random ties");
+  opt.branching(Queens::BRANCH_ACTION, "action", "Largest action over size, random ties");
+  opt.branching(Queens::BRANCH_CHB, "chb", "Largest CHB over size, random ties");
 
 #if defined(GECODE_HAS_QT) && defined(GECODE_HAS_GIST)
   QueensInspector ki;
@@ -226,9 +588,106 @@ main(int argc, char* argv[]) {
 #endif
 
   opt.parse(argc,argv);
-  Script::run<Queens,DFS,SizeOptions>(opt);
+  if (opt.count()) {
+    Counter c(opt);
+    Support::Timer t;
+    t.start();
+    c.run();
+    double time = t.stop();
+    std::cout << "Summary" << std::endl
+              << "\truntime:    " << time << " ms" << std::endl
+              << "\tsolutions:  " << c.solutions << std::endl;
+    if (opt.symmetry())
+      std::cout << "\tclasses:    " << c.classes
+                << " (solutions up to symmetry)" << std::endl;
+    std::cout << "\tjobs:       " << c.prefixes.size() / std::max(c.k,1)
+              << " (" << c.k << " rows fixed)" << std::endl
+              << "\tnodes:      " << c.nodes << std::endl
+              << "\tfailures:   " << c.failures << std::endl
+              << "\tthroughput: "
+              << ((time > 0.0) ? c.solutions / time * 1000.0 : 0.0)
+              << " solutions/s" << std::endl;
+    return 0;
+  }
+  if (opt.runs() > 0) {
+    runtimes<Queens>(opt);
+    return 0;
+  }
+  if (opt.local()) {
+    const int n = opt.size();
+    Support::Timer t;
+    t.start();
+    MinConflicts m(n, opt.seed());
+    bool found = m.solve(1024);
+    double time = t.stop();
+    if (!found) {
+      std::cout << "No solution found" << std::endl;
+    } else if (n <= 1000) {
+      // Larger boards only get the summary
+      std::cout << "queens\t";
+      for (int i = 0; i < n; i++) {
+        std::cout << m.c[i] << ", ";
+        if ((i+1) % 10 == 0)
+          std::cout << std::endl << "\t";
+      }
+      std::cout << std::endl;
+    }
+    std::cout << "Summary" << std::endl
+              << "\truntime:    " << time << " ms" << std::endl
+              << "\tswaps:      " << m.swaps << " of " << m.tries
+              << " tried" << std::endl
+              << "\trestarts:   " << m.restarts << std::endl
+              << "\tmemory:     "
+              << (m.c.size() + m.d1.size() + m.d2.size()) * sizeof(int) / 1024
+              << " KB" << std::endl;
+    if (found && opt.check()) {
+      // Assign the solution to the model and propagate its constraints
+      Support::Timer tc;
+      tc.start();
+      Queens* s = new Queens(opt);
+      for (int i = 0; i < n; i++)
+        rel(*s, s->q[i], IRT_EQ, m.c[i]);
+      bool ok = (s->status() != SS_FAILED);
+      std::cout << "\tcheck:      "
+                << (ok ? "solution of the model" : "VIOLATES the model")
+                << " (" << tc.stop() << " ms)" << std::endl;
+      delete s;
+    }
+    return 0;
+  }
+  Script::run<Queens,DFS,QueensOptions>(opt);
   return 0;
 }
 
 // STATISTICS: example-any
 
+
+// Comments:
+
+// Counting (-count):
+// queensDistinct -count -size 17 -threads 0
+// counts all solutions without printing any. The 8 symmetries of the board
+// are broken by lexicographic constraints (the solution is at most each of
+// its images, using the inverse permutation for the transposing ones), and
+// every solution found counts for the number of different images it has
+// (8, 2 for the rare solutions with a 90 degree symmetry, 4 with only a
+// 180 degree symmetry). -symmetry false counts every solution separately, to
+// check the weighting. The tree is split into one job per way to place the
+// first -prefix queens.
+
+// Local search (-local):
+// queensDistinct -local -size 1000000 -seed 3
+// solves large boards with min-conflicts repair (class MinConflicts)
+// instead of search. Only the columns and the number of queens on every
+// diagonal are kept (three int arrays, 12n bytes), a 10^6 board takes well
+// under a second. -check posts the solution into the model (with the
+// constraints of -propagation, use distinct for large n) and propagates.
+
+// Restarts and learned orderings:
+// -branching afc|action|chb select the variable with the largest AFC, action
+// or CHB (over its domain size), ties at random from -seed. Together with
+// -restart luby|geometric (-restart-scale, -restart-base) the search starts
+// over with what it has learned whenever the cutoff is reached.
+// queensDistinct -size 200 -branching afc -restart luby -runs 100 -time 10000
+// prints the runtime distribution over 100 seeds; compare it to a run
+// without -restart to see the tail that restarts cut off.
@@ -0,0 +1,249 @@
+/* -*- mode: C++; c-basic-offset: 2; indent-tabs-mode: nil -*- */
+/*
+ * Dual model of n-queens: the board as n*n Boolean cells (the matrix
+ * view of queens.cpp) and the column of the queen of every row (the
+ * permutation view of queensDistinct.cpp), linked by channeling.
+ *
+ * The permutation prunes with the three distinct constraints, the
+ * matrix with the lines propagator (lines.cpp), and every row of cells
+ * is channeled to the queen of the row, so each side sees what the
+ * other one removes.
+ */
+
+#include <gecode/driver.hh>
+#include <gecode/int.hh>
+#include <gecode/minimodel.hh>
+
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "lines.cpp"
+
+using namespace Gecode;
+
+/// Options for the dual model
+class QueensOptions : public SizeOptions {
+protected:
+  /// Sizes to compare the models on
+  Driver::StringValueOption _benchmark;
+public:
+  /// Initialize options for script with name \a s
+  QueensOptions(const char* s) : SizeOptions(s),
+    _benchmark("benchmark",
+               "compare all models on these sizes (comma separated)") {
+    add(_benchmark);
+  }
+  /// Return sizes to compare the models on, NULL if none
+  const char* benchmark(void) const {
+    return _benchmark.value();
+  }
+};
+
+/**
+ * \brief %Example: n-%Queens puzzle with matrix and permutation view
+ *
+ * Place n queens on an n times n chessboard such that they do not
+ * attack each other.
+ *
+ */
+class Queens : public Script {
+public:
+  /// The cells of the board, row by row (matrix view)
+  BoolVarArray q;
+  /// The column of the queen of every row (permutation view)
+  IntVarArray p;
+  /// Model variants
+  enum {
+    MODEL_MATRIX,      ///< Only the cells with the lines propagator
+    MODEL_PERMUTATION, ///< Only the columns with three distinct constraints
+    MODEL_DUAL         ///< Both views, channeled
+  };
+  /// Branching to use for model
+  enum {
+    BRANCH_PERMUTATION, ///< First fail on the columns
+    BRANCH_MATRIX       ///< Queens on the cells, row by row
+  };
+protected:
+  /// Post the views of model \a m for size \a n and branch with \a b
+  void model(const Options& opt, int n, int m, int b) {
+    if (m != MODEL_PERMUTATION) {
+      q = BoolVarArray(*this, n*n, 0, 1);
+      lines(*this, q);
+    }
+    if (m != MODEL_MATRIX) {
+      p = IntVarArray(*this, n, 0, n-1);
+      distinct(*this, IntArgs::create(n,0,1), p, opt.ipl());
+      distinct(*this, IntArgs::create(n,0,-1), p, opt.ipl());
+      distinct(*this, p, opt.ipl());
+    }
+    if (m == MODEL_DUAL) {
+      Matrix<BoolVarArray> mat(q, n);
+      // Cell (r,c) holds a queen if and only if the queen of row r is in column c
+      for (int r=0; r<n; r++)
+        channel(*this, mat.row(r), p[r]);
+    }
+    // A view that is not there can not be branched on
+    if (m == MODEL_MATRIX)
+      b = BRANCH_MATRIX;
+    else if (m == MODEL_PERMUTATION)
+      b = BRANCH_PERMUTATION;
+    switch (b) {
+    case BRANCH_PERMUTATION:
+      branch(*this, p, INT_VAR_SIZE_MIN(), INT_VAL_MIN());
+      break;
+    case BRANCH_MATRIX:
+      branch(*this, q, BOOL_VAR_NONE(), BOOL_VAL_MAX());
+      break;
+    }
+  }
+public:
+  /// The actual problem
+  Queens(const SizeOptions& opt) : Script(opt) {
+    model(opt, opt.size(), opt.model(), opt.branching());
+  }
+  /// The problem of size \a n with model \a m and branching \a b
+  Queens(const SizeOptions& opt, int n, int m, int b) : Script(opt) {
+    model(opt, n, m, b);
+  }
+
+  /// Constructor for cloning \a s
+  Queens(Queens& s) : Script(s) {
+    q.update(*this, s.q);
+    p.update(*this, s.p);
+  }
+
+  /// Perform copying during cloning
+  virtual Space*
+  copy(void) {
+    return new Queens(*this);
+  }
+
+  /// Print solution
+  virtual void
+  print(std::ostream& os) const {
+    os << "queens\t";
+    if (p.size() > 0) {
+      for (int i = 0; i < p.size(); i++) {
+        os << p[i] << ", ";
+        if ((i+1) % 10 == 0)
+          os << std::endl << "\t";
+      }
+    } else {
+      // The column of the queen of every row, from the cells
+      int n = 0;
+      while (n*n < q.size())
+        n++;
+      for (int i = 0; i < n; i++) {
+        int c = -1;
+        for (int j = 0; j < n; j++)
+          if (q[i*n+j].one())
+            c = j;
+        if (c < 0)
+          os << "_, ";
+        else
+          os << c << ", ";
+        if ((i+1) % 10 == 0)
+          os << std::endl << "\t";
+      }
+    }
+    os << std::endl;
+  }
+};
+
+/// Search for the first solution of every model at every size of -benchmark
+void benchmark(const QueensOptions& opt) {
+  static const char* name[] = {"matrix", "permutation", "dual"};
+  std::cout << std::setw(6) << "size" << std::setw(13) << "model"
+            << std::setw(12) << "nodes" << std::setw(12) << "failures"
+            << std::setw(12) << "time (ms)" << std::setw(14) << "nodes/s"
+            << std::endl;
+  std::istringstream sizes(opt.benchmark());
+  std::string size;
+  while (std::getline(sizes, size, ',')) {
+    int n = std::atoi(size.c_str());
+    if (n < 1)
+      continue;
+    for (int m = Queens::MODEL_MATRIX; m <= Queens::MODEL_DUAL; m++) {
+      Search::Options so;
+      so.threads = 1;
+      so.clone = false;
+      // -time and -node bound each search, not the whole benchmark
+      so.stop = Driver::CombinedStop::create(opt.node(), opt.fail(),
+                                             opt.time(), false);
+      Support::Timer t;
+      t.start();
+      DFS<Queens> e(new Queens(opt, n, m, opt.branching()), so);
+      Queens* s = e.next();
+      double time = t.stop();
+      Search::Statistics stat = e.statistics();
+      std::cout << std::setw(6) << n << std::setw(13) << name[m]
+                << std::setw(12) << stat.node << std::setw(12) << stat.fail
+                << std::setw(12) << std::fixed << std::setprecision(1) << time
+                << std::setw(14) << std::setprecision(0)
+                << ((time > 0.0) ? stat.node / time * 1000.0 : 0.0);
+      if (s == NULL)
+        std::cout << (e.stopped() ? "  (stopped)" : "  (no solution)");
+      std::cout << std::endl;
+      delete s;
+      delete so.stop;
+    }
+  }
+}
+
+/** \brief Main-function
+ *  \relates Queens
+ */
+int
+main(int argc, char* argv[]) {
+  QueensOptions opt("Queens");
+  opt.iterations(500);
+  opt.size(200);
+  opt.ipl(IPL_DOM);
+  opt.model(Queens::MODEL_DUAL);
+  opt.model(Queens::MODEL_MATRIX, "matrix",
+            "cells with the lines propagator");
+  opt.model(Queens::MODEL_PERMUTATION, "permutation",
+            "columns with three distinct constraints");
+  opt.model(Queens::MODEL_DUAL, "dual",
+            "cells and columns, channeled");
+  opt.branching(Queens::BRANCH_PERMUTATION);
+  opt.branching(Queens::BRANCH_PERMUTATION, "permutation",
+                "first fail on the columns");
+  opt.branching(Queens::BRANCH_MATRIX, "matrix",
+                "queens on the cells, row by row");
+  opt.parse(argc,argv);
+  if (opt.benchmark() != NULL) {
+    benchmark(opt);
+    return 0;
+  }
+  Script::run<Queens,DFS,QueensOptions>(opt);
+  return 0;
+}
+
+// STATISTICS: example-any
+
+// Comments:
+
+// Views:
+// matrix: n^2 Boolean cells, one lines propagator (as in queens.cpp)
+// permutation: n columns, three distinct constraints (as in queensDistinct.cpp)
+// dual: both, with n channel constraints between a row of cells and its column
+
+// Each side prunes the other: a value removed from p[r] by distinct zeroes
+// cell (r,c), and a cell zeroed by a queen on its diagonal removes c from
+// p[r]. The lines propagator also forces a queen into a column with a single
+// open cell, which the distinct constraints only find with domain
+// propagation (-ipl dom, the default here).
+
+// Branching:
+// -branching permutation (default): first fail on the columns
+// -branching matrix: the first open cell of the board gets a queen
+// The matrix and permutation models always use their own side.
+
+// Benchmark:
+// queensDual -benchmark 200,500,1000 -time 60000
+// prints nodes, failures, runtime and nodes/s to the first solution of all
+// three models with the same -ipl and -branching, every search bounded by
+// -time, -node and -fail.
@@ -0,0 +1,114 @@
+/*
+ * Runtime distribution of the first solution over many seeds, shared by
+ * the models with learned branchings and restarts (queensDistinct.cpp and
+ * magicSequence.cpp).
+ *
+ * The first solution is searched once for every seed from -seed on, with
+ * restart-based search if -restart asks for it. Every run is bounded by
+ * -time, -node and -fail. The report gives runtime and node quantiles,
+ * the mean runtime and restarts per run, and the runs per power of two
+ * of the runtime: a heavy tail shows as a few runs far to the right.
+ *
+ * As with lines.cpp, include (or paste) this file into your model, which
+ * needs options with runs() (the number of seeds).
+ */
+
+#include <gecode/driver.hh>
+#include <gecode/search.hh>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace Gecode;
+
+// The cutoff for -restart, NULL without restarts
+Search::Cutoff* cutoff(const Options& opt) {
+  switch (opt.restart()) {
+  case RM_CONSTANT:
+    return Search::Cutoff::constant(opt.restart_scale());
+  case RM_LINEAR:
+    return Search::Cutoff::linear(opt.restart_scale());
+  case RM_LUBY:
+    return Search::Cutoff::luby(opt.restart_scale());
+  case RM_GEOMETRIC:
+    return Search::Cutoff::geometric(opt.restart_scale(),
+                                     opt.restart_base());
+  default:
+    return NULL;
+  }
+}
+
+// Search the first solution of script S for opt.runs() seeds and print the distribution
+template<class S, class O>
+void runtimes(O& opt) {
+  const unsigned int seed = opt.seed();
+  std::vector<double> times;
+  std::vector<unsigned long int> nodes;
+  unsigned long int restarts = 0;
+  unsigned int stopped = 0;
+  for (unsigned int k = 0; k < opt.runs(); k++) {
+    opt.seed(seed + k);
+    Search::Options so;
+    so.threads = 1;
+    so.clone = false;
+    so.stop = Driver::CombinedStop::create(opt.node(), opt.fail(),
+                                           opt.time(), false);
+    so.cutoff = cutoff(opt);
+    Support::Timer t;
+    t.start();
+    S* s = new S(opt);
+    S* sol;
+    Search::Statistics stat;
+    bool stop;
+    if (so.cutoff != NULL) {
+      RBS<S,DFS> e(s, so);
+      sol = e.next(); stat = e.statistics(); stop = e.stopped();
+    } else {
+      DFS<S> e(s, so);
+      sol = e.next(); stat = e.statistics(); stop = e.stopped();
+    }
+    times.push_back(t.stop());
+    nodes.push_back(stat.node);
+    restarts += stat.restart;
+    if ((sol == NULL) && stop)
+      stopped++;
+    delete sol;
+    delete so.stop;
+  }
+  opt.seed(seed);
+  std::sort(times.begin(), times.end());
+  std::sort(nodes.begin(), nodes.end());
+  const size_t m = times.size();
+  if (m == 0)
+    return;
+  double mean = 0.0;
+  for (size_t i = 0; i < m; i++)
+    mean += times[i];
+  mean /= m;
+  static const double at[] = {0.0, 0.25, 0.5, 0.75, 0.9, 0.99, 1.0};
+  static const char* label[] = {"min", "25%", "median", "75%", "90%",
+                                "99%", "max"};
+  std::cout << "Runtime distribution over " << m << " seeds ("
+            << stopped << " stopped)" << std::endl;
+  for (int i = 0; i < 7; i++) {
+    size_t j = static_cast<size_t>(at[i] * (m - 1) + 0.5);
+    std::cout << "\t" << label[i] << ":\t" << times[j] << " ms\t"
+              << nodes[j] << " nodes" << std::endl;
+  }
+  std::cout << "\tmean:\t" << mean << " ms" << std::endl
+            << "\trestarts:\t" << static_cast<double>(restarts) / m
+            << " per run" << std::endl;
+  // Runs per power of two of the runtime, the tail to the right
+  std::cout << "Runs by runtime" << std::endl;
+  for (size_t i = 0; i < m; ) {
+    double hi = 1.0;
+    while (hi <= times[i])
+      hi *= 2.0;
+    size_t j = i;
+    while ((j < m) && (times[j] < hi))
+      j++;
+    std::cout << "\t< " << hi << " ms:\t" << (j - i) << std::endl;
+    i = j;
+  }
+}
@@ -0,0 +1,194 @@
+/*
+ * Capacity propagator for square packing: the total size of the squares
+ * crossing any column (or row) can not exceed the size of the enclosing
+ * square. This is the cumulative redundancy of the packing, with the
+ * squares as tasks whose duration and resource usage are both their size.
+ *
+ * As with no-overlap.cpp, include (or paste) this file into your model.
+ */
+
+#include <gecode/int.hh>
+
+using namespace Gecode;
+using namespace Gecode::Int;
+
+// The capacity propagator
+class Capacity : public Propagator {
+protected:
+  // A start or end of a compulsory part
+  class Event {
+  public:
+    // Position of the event
+    int pos;
+    // Change of the profile height at the position
+    int inc;
+  };
+  // Order events by increasing position
+  class ByPos {
+  public:
+    bool operator ()(const Event& l, const Event& r) const {
+      return l.pos < r.pos;
+    }
+  };
+  // A part [lo,hi) of the profile with constant height h
+  class Segment {
+  public:
+    int lo, hi, h;
+  };
+  // The coordinates
+  ViewArray<IntView> x;
+  // The sizes of the squares (array, shared between all clones)
+  IntSharedArray d;
+  // The size of the enclosing square
+  IntView s;
+public:
+  // Create propagator and initialize
+  Capacity(Home home, ViewArray<IntView>& x0, IntSharedArray& d0, IntView s0)
+    : Propagator(home), x(x0), d(d0), s(s0) {
+    x.subscribe(home,*this,PC_INT_BND);
+    s.subscribe(home,*this,PC_INT_BND);
+    // The shared array must be released when the space is deleted
+    home.notice(*this,AP_DISPOSE);
+  }
+  // Post capacity propagator
+  static ExecStatus post(Home home,
+                         ViewArray<IntView>& x, IntSharedArray& d,
+                         IntView s) {
+    // Only if there is something to propagate
+    if (x.size() > 0)
+      (void) new (home) Capacity(home,x,d,s);
+    return ES_OK;
+  }
+
+  // Copy constructor during cloning
+  Capacity(Space& home, Capacity& p)
+    : Propagator(home,p), d(p.d) {
+    x.update(home,p.x);
+    s.update(home,p.s);
+  }
+  // Create copy during cloning
+  virtual Propagator* copy(Space& home) {
+    return new (home) Capacity(home,*this);
+  }
+
+  // Re-schedule function after propagator has been re-enabled
+  virtual void reschedule(Space& home) {
+    x.reschedule(home,*this,PC_INT_BND);
+    s.reschedule(home,*this,PC_INT_BND);
+  }
+
+  // Return cost (sorting plus one sweep per square)
+  virtual PropCost cost(const Space&, const ModEventDelta&) const {
+    return PropCost::quadratic(PropCost::LO,x.size());
+  }
+
+  /*
+   * Perform propagation: build the profile of the compulsory parts
+   * (between the latest start and the earliest end of each square) with
+   * a sweep over their sorted start and end events. The enclosing square
+   * must be at least as large as the highest point of the profile, and
+   * every square is pushed past the parts of the profile where it does
+   * not fit on top.
+   */
+  virtual ExecStatus propagate(Space& home, const ModEventDelta&) {
+    Region r;
+    Event* e = r.alloc<Event>(2*x.size());
+    int n_e = 0;
+    for (int i=0; i<x.size(); i++)
+      if (x[i].max() < x[i].min() + d[i]) {
+        e[n_e].pos = x[i].max();        e[n_e].inc = d[i];  n_e++;
+        e[n_e].pos = x[i].min() + d[i]; e[n_e].inc = -d[i]; n_e++;
+      }
+    // Without compulsory parts there is nothing to propagate
+    if (n_e == 0)
+      return ES_FIX;
+    ByPos byPos;
+    Support::quicksort<Event,ByPos>(e,n_e,byPos);
+
+    // Sweep over the events, collecting the segments of the profile
+    Segment* sg = r.alloc<Segment>(n_e);
+    int n_sg = 0, height = 0, hmax = 0;
+    for (int k=0; k<n_e; ) {
+      int pos = e[k].pos;
+      while ((k < n_e) && (e[k].pos == pos)) {
+        height += e[k].inc; k++;
+      }
+      // A positive height means that there are further events
+      if (height > 0) {
+        sg[n_sg].lo = pos; sg[n_sg].hi = e[k].pos; sg[n_sg].h = height;
+        n_sg++;
+        if (height > hmax)
+          hmax = height;
+      }
+    }
+    GECODE_ME_CHECK(s.gq(home,hmax));
+
+    int c = s.max();
+    for (int i=0; i<x.size(); i++) {
+      if (x[i].assigned())
+        continue;
+      // Own compulsory part, not counted against the square itself
+      int lo = x[i].max(), hi = x[i].min() + d[i];
+      // Earliest position where the square fits on top of the profile
+      int p = x[i].min();
+      for (int k=0; k<n_sg; k++) {
+        int h = sg[k].h;
+        if ((lo <= sg[k].lo) && (sg[k].hi <= hi))
+          h -= d[i];
+        if ((h + d[i] > c) && (p + d[i] > sg[k].lo) && (p < sg[k].hi))
+          p = sg[k].hi;
+      }
+      // Latest position where the square fits on top of the profile
+      int q = x[i].max();
+      for (int k=n_sg; k--; ) {
+        int h = sg[k].h;
+        if ((lo <= sg[k].lo) && (sg[k].hi <= hi))
+          h -= d[i];
+        if ((h + d[i] > c) && (q + d[i] > sg[k].lo) && (q < sg[k].hi))
+          q = sg[k].lo - d[i];
+      }
+      GECODE_ME_CHECK(x[i].gq(home,p));
+      GECODE_ME_CHECK(x[i].lq(home,q));
+    }
+
+    // The profile can only be violated as long as something may change
+    if (x.assigned() && s.assigned())
+      return home.ES_SUBSUMED(*this);
+    return ES_NOFIX;
+  }
+
+  // Bytes of the shared sizes, which a clone does not copy
+  size_t shared(void) const {
+    return d.size()*sizeof(int);
+  }
+
+  // Dispose propagator and return its size
+  virtual size_t dispose(Space& home) {
+    x.cancel(home,*this,PC_INT_BND);
+    s.cancel(home,*this,PC_INT_BND);
+    home.ignore(*this,AP_DISPOSE);
+    d.~IntSharedArray();
+    (void) Propagator::dispose(home);
+    return sizeof(*this);
+  }
+};
+
+/*
+ * Post the constraint that the total size of the squares with
+ * coordinates x and sizes d crossing any line is at most s.
+ */
+void capacity(Home home,
+              const IntVarArgs& x, const IntArgs& d, IntVar s) {
+  // Check whether the arguments make sense
+  if (x.size() != d.size())
+    throw ArgumentSizeMismatch("capacity");
+  // Never post a propagator in a failed space
+  if (home.failed()) return;
+  // Set up array of views for the coordinates
+  ViewArray<IntView> vx(home,x);
+  // Set up shared array for the sizes, clones only copy the reference
+  IntSharedArray dc(d);
+  // If posting failed, fail space
+  if (Capacity::post(home,vx,dc,s) != ES_OK)
+    home.fail();
+}
@@ -34,59 +34,318 @@ using namespace Gecode::Int;
 // The no-overlap propagator
 class NoOverlap : public Propagator {
 protected:
+  // Advisor for a single coordinate of a rectangle
+  class ViewAdvisor : public Advisor {
+  public:
+    // Index of the rectangle
+    int i;
+    // Whether the advisor is for the y-coordinate
+    bool isY;
+    // Create advisor
+    ViewAdvisor(Space& home, Propagator& p, 
+                Council<ViewAdvisor>& c, int i0, bool y0)
+      : Advisor(home,p,c), i(i0), isY(y0) {}
+    // Copy advisor during cloning
+    ViewAdvisor(Space& home, ViewAdvisor& a)
+      : Advisor(home,a), i(a.i), isY(a.isY) {}
+  };
+  // Compulsory part of a rectangle, a is the pruned and b the other dimension
+  class Box {
+  public:
+    // Index of the rectangle
+    int i;
+    // Extent in both dimensions (inclusive)
+    int alo, ahi, blo, bhi;
+  };
+  // Order boxes by increasing lower end
+  class ByLow {
+  public:
+    bool operator ()(const Box& l, const Box& r) const {
+      return l.alo < r.alo;
+    }
+  };
+  // Order boxes by decreasing upper end
+  class ByHigh {
+  public:
+    bool operator ()(const Box& l, const Box& r) const {
+      return l.ahi > r.ahi;
+    }
+  };
+  // A range of lines covered by a fixed rectangle
+  typedef Iter::Ranges::Array::Range Range;
+  // Order ranges by increasing minimum
+  class ByMin {
+  public:
+    bool operator ()(const Range& l, const Range& r) const {
+      return l.min < r.min;
+    }
+  };
   // The x-coordinates
   ViewArray<IntView> x;
-  // The width (array)
-  int* w;
+  // The width (array, shared between all clones)
+  IntSharedArray w;
   // The y-coordinates
   ViewArray<IntView> y;
-  // The heights (array)
-  int* h;
+  // The heights (array, shared between all clones)
+  IntSharedArray h;
+  // The advisors
+  Council<ViewAdvisor> c;
+  // Stack of assigned coordinates not yet propagated (2*i for x, 2*i+1 for y)
+  int* pending;
+  // Number of entries on the pending stack
+  int n_pending;
+  // Coordinates already propagated per rectangle (bit 0 for x, bit 1 for y)
+  unsigned char* done;
+  // Rectangles with both coordinates propagated, sorted by x-coordinate
+  int* fx;
+  // Rectangles with both coordinates propagated, sorted by y-coordinate
+  int* fy;
+  // Number of fixed rectangles
+  int n_fixed;
+  // Largest width and height, bounds how far back a query must look
+  int wmax, hmax;
+  // Whether compulsory parts are propagated as well (bounds level)
+  bool bnd;
+
+  // Push assigned coordinate onto the pending stack
+  void assigned(int i, bool isY) {
+    pending[n_pending++] = 2*i + (isY ? 1 : 0);
+  }
+  // Prune y[i] if x[i] collides with the fixed rectangle j
+  ExecStatus pruneY(Space& home, int i, int j) {
+    if (x[i].val() >= x[j].val() && x[i].val() < x[j].val() + w[j]) {
+      //x are colliding, prune y
+      Iter::Ranges::Singleton r(y[j].val(), y[j].val() + h[j] - 1);
+      GECODE_ME_CHECK(y[i].minus_r(home, r, false));
+    }
+    return ES_OK;
+  }
+  // Prune x[i] if y[i] collides with the fixed rectangle j
+  ExecStatus pruneX(Space& home, int i, int j) {
+    if (y[i].val() >= y[j].val() && y[i].val() < y[j].val() + h[j]) {
+      //y are colliding, prune x
+      Iter::Ranges::Singleton r(x[j].val(), x[j].val() + w[j] - 1);
+      GECODE_ME_CHECK(x[i].minus_r(home, r, false));
+    }
+    return ES_OK;
+  }
+  // Insert fixed rectangle i into the list s of n rectangles sorted by a
+  static void insert(ViewArray<IntView>& a, int* s, int n, int i) {
+    int k = n;
+    while ((k > 0) && (a[s[k-1]].val() > a[i].val())) {
+      s[k] = s[k-1]; k--;
+    }
+    s[k] = i;
+  }
+  /*
+   * Remove from b[i] all lines covered by fixed rectangles which overlap
+   * the assigned a[i]. The list s of n fixed rectangles is sorted by a,
+   * so only the rectangles starting in (a[i]-amax, a[i]] are looked at.
+   * The ranges they cover in b are removed with a single domain operation.
+   * Touching rectangles give adjacent ranges, and before all pending
+   * coordinates are propagated two fixed rectangles may even overlap, so
+   * the ranges are merged first: a range iterator must be increasing,
+   * disjoint and non-adjacent.
+   */
+  static ExecStatus prune(Space& home, int i,
+                          ViewArray<IntView>& a, const IntSharedArray& wa,
+                          int amax,
+                          int* s, int n,
+                          ViewArray<IntView>& b, const IntSharedArray& wb) {
+    int v = a[i].val();
+    // Find the first fixed rectangle starting after v
+    int l = 0, u = n;
+    while (l < u) {
+      int m = (l + u) / 2;
+      if (a[s[m]].val() <= v)
+        l = m + 1;
+      else
+        u = m;
+    }
+    Region r;
+    Range* rs = r.alloc<Range>(u);
+    int n_rs = 0;
+    for (int k = u - 1; (k >= 0) && (a[s[k]].val() > v - amax); k--) {
+      int j = s[k];
+      if ((j != i) && (a[j].val() + wa[j] > v)) {
+        rs[n_rs].min = b[j].val(); rs[n_rs].max = b[j].val() + wb[j] - 1;
+        n_rs++;
+      }
+    }
+    if (n_rs == 0)
+      return ES_OK;
+    ByMin byMin;
+    Support::quicksort<Range,ByMin>(rs,n_rs,byMin);
+    int n_m = 0;
+    for (int k = 1; k < n_rs; k++)
+      if (rs[k].min <= rs[n_m].max + 1) {
+        if (rs[k].max > rs[n_m].max)
+          rs[n_m].max = rs[k].max;
+      } else {
+        rs[++n_m] = rs[k];
+      }
+    Iter::Ranges::Array ra(rs,n_m + 1);
+    GECODE_ME_CHECK(b[i].minus_r(home,ra,false));
+    return ES_OK;
+  }
+  /*
+   * Sweep dimension a against the compulsory parts of all rectangles:
+   * a rectangle i whose compulsory part in b shares a line with the
+   * compulsory part of another rectangle must be placed completely
+   * before or after it in a. The bounds of a[i] are pushed over all such
+   * parts, sorted by their lower (or upper) end so that a single pass
+   * also skips chains of adjacent parts.
+   */
+  static ExecStatus sweep(Space& home, bool& changed,
+                          ViewArray<IntView>& a, const IntSharedArray& wa,
+                          ViewArray<IntView>& b, const IntSharedArray& wb) {
+    Region r;
+    Box* lo = r.alloc<Box>(a.size());
+    int n = 0;
+    for (int i=0; i<a.size(); i++) {
+      Box& bx = lo[n];
+      bx.i = i;
+      bx.alo = a[i].max(); bx.ahi = a[i].min() + wa[i] - 1;
+      bx.blo = b[i].max(); bx.bhi = b[i].min() + wb[i] - 1;
+      if ((bx.alo <= bx.ahi) && (bx.blo <= bx.bhi))
+        n++;
+    }
+    if (n == 0)
+      return ES_OK;
+    Box* hi = r.alloc<Box>(n);
+    for (int k=n; k--; )
+      hi[k] = lo[k];
+    ByLow byLow; ByHigh byHigh;
+    Support::quicksort<Box,ByLow>(lo,n,byLow);
+    Support::quicksort<Box,ByHigh>(hi,n,byHigh);
+
+    for (int i=0; i<a.size(); i++) {
+      if (a[i].assigned())
+        continue;
+      // Lines in b which rectangle i certainly occupies
+      int blo = b[i].max(), bhi = b[i].min() + wb[i] - 1;
+      if (blo > bhi)
+        continue;
+      // Earliest position not overlapping any compulsory part
+      int p = a[i].min();
+      for (int k=0; k<n; k++)
+        if ((lo[k].i != i) && (lo[k].blo <= bhi) && (blo <= lo[k].bhi) &&
+            (p + wa[i] > lo[k].alo) && (p <= lo[k].ahi))
+          p = lo[k].ahi + 1;
+      // Latest position not overlapping any compulsory part
+      int q = a[i].max();
+      for (int k=0; k<n; k++)
+        if ((hi[k].i != i) && (hi[k].blo <= bhi) && (blo <= hi[k].bhi) &&
+            (q + wa[i] > hi[k].alo) && (q <= hi[k].ahi))
+          q = hi[k].alo - wa[i];
+      ModEvent me = a[i].gq(home,p);
+      if (me_failed(me))
+        return ES_FAILED;
+      changed |= me_modified(me);
+      me = a[i].lq(home,q);
+      if (me_failed(me))
+        return ES_FAILED;
+      changed |= me_modified(me);
+    }
+    return ES_OK;
+  }
 public:
   // Create propagator and initialize
   NoOverlap(Home home, 
-            ViewArray<IntView>& x0, int w0[], 
-            ViewArray<IntView>& y0, int h0[])
-    : Propagator(home), x(x0), w(w0), y(y0), h(h0) {
-    x.subscribe(home,*this,PC_INT_BND);
-    y.subscribe(home,*this,PC_INT_BND);
+            ViewArray<IntView>& x0, IntSharedArray& w0, 
+            ViewArray<IntView>& y0, IntSharedArray& h0, bool bnd0)
+    : Propagator(home), x(x0), w(w0), y(y0), h(h0), c(home),
+      n_pending(0), n_fixed(0), wmax(0), hmax(0), bnd(bnd0) {
+    // The shared arrays must be released when the space is deleted
+    home.notice(*this,AP_DISPOSE);
+    int n = x.size();
+    pending = home.alloc<int>(2*n);
+    done = home.alloc<unsigned char>(n);
+    fx = home.alloc<int>(n);
+    fy = home.alloc<int>(n);
+    for (int i=0; i<n; i++) {
+      done[i] = 0;
+      if (w[i] > wmax) wmax = w[i];
+      if (h[i] > hmax) hmax = h[i];
+      // Only unassigned coordinates need an advisor
+      if (x[i].assigned())
+        assigned(i,false);
+      else
+        x[i].subscribe(home,*new (home) ViewAdvisor(home,*this,c,i,false));
+      if (y[i].assigned())
+        assigned(i,true);
+      else
+        y[i].subscribe(home,*new (home) ViewAdvisor(home,*this,c,i,true));
+    }
+    if (bnd)
+      IntView::schedule(home,*this,ME_INT_BND);
+    else if (n_pending > 0)
+      IntView::schedule(home,*this,ME_INT_VAL);
   }
   // Post no-overlap propagator
   static ExecStatus post(Home home, 
-                         ViewArray<IntView>& x, int w[], 
-                         ViewArray<IntView>& y, int h[]) {
+                         ViewArray<IntView>& x, IntSharedArray& w, 
+                         ViewArray<IntView>& y, IntSharedArray& h, bool bnd) {
     // Only if there is something to propagate
     if (x.size() > 1)
-      (void) new (home) NoOverlap(home,x,w,y,h);
+      (void) new (home) NoOverlap(home,x,w,y,h,bnd);
     return ES_OK;
   }
 
   // Copy constructor during cloning
   NoOverlap(Space& home, NoOverlap& p)
-    : Propagator(home,p) {
+    : Propagator(home,p), w(p.w), h(p.h),
+      n_pending(p.n_pending), n_fixed(p.n_fixed),
+      wmax(p.wmax), hmax(p.hmax), bnd(p.bnd) {
     x.update(home,p.x);
     y.update(home,p.y);
-    // Also copy width and height arrays
-    w = home.alloc<int>(x.size());
-    h = home.alloc<int>(y.size());
-    for (int i=x.size(); i--; ) {
-      w[i]=p.w[i]; h[i]=p.h[i];
+    c.update(home,p.c);
+    // Copy the incremental state
+    pending = home.alloc<int>(2*x.size());
+    for (int i=n_pending; i--; )
+      pending[i]=p.pending[i];
+    done = home.alloc<unsigned char>(x.size());
+    for (int i=x.size(); i--; )
+      done[i]=p.done[i];
+    fx = home.alloc<int>(x.size());
+    fy = home.alloc<int>(x.size());
+    for (int i=n_fixed; i--; ) {
+      fx[i]=p.fx[i]; fy[i]=p.fy[i];
     }
   }
   // Create copy during cloning
   virtual Propagator* copy(Space& home) {
     return new (home) NoOverlap(home,*this);
   }
+  // Bytes of the shared widths and heights, which a clone does not copy
+  size_t shared(void) const {
+    return (w.size() + h.size())*sizeof(int);
+  }
 
   // Re-schedule function after propagator has been re-enabled
   virtual void reschedule(Space& home) {
-     x.reschedule(home,*this,PC_INT_BND);
-     y.reschedule(home,*this,PC_INT_BND);
+    if (bnd)
+      IntView::schedule(home,*this,ME_INT_BND);
+    else if (n_pending > 0)
+      IntView::schedule(home,*this,ME_INT_VAL);
   }
 
-  // Return cost (defined as cheap quadratic)
+  // Return cost (linear for assignments, the sweep sorts all rectangles)
   virtual PropCost cost(const Space&, const ModEventDelta&) const {
-    return PropCost::quadratic(PropCost::LO,2*x.size());
+    if (bnd)
+      return PropCost::quadratic(PropCost::LO,2*x.size());
+    return PropCost::linear(PropCost::LO,2*x.size());
+  }
+
+  // Record coordinates that became assigned
+  virtual ExecStatus advise(Space& home, Advisor& a0, const Delta& d) {
+    ViewAdvisor& a = static_cast<ViewAdvisor&>(a0);
+    IntView v = a.isY ? y[a.i] : x[a.i];
+    // Only assignments are interesting, and bound changes for the sweep
+    if (!v.assigned())
+      return (bnd && (IntView::modevent(d) == ME_INT_BND)) ? ES_NOFIX : ES_FIX;
+    assigned(a.i,a.isY);
+    return home.ES_NOFIX_DISPOSE(c,a);
   }
 
   // Perform propagation
@@ -96,48 +355,85 @@ public:
   */
   virtual ExecStatus propagate(Space& home, const ModEventDelta&) {
 
-	  for (int i = 0; i < x.size(); i++) {
-		  for (int j = 0; j < x.size(); j++) {
-			  if (j != i) {
-				  if (x[j].assigned() && y[j].assigned()) { 
-
-					  if (x[i].assigned() && x[i].val() >= x[j].val() && x[i].val() < x[j].val() + w[j]) {
-						  //x are colliding, prune y
-						  for (int k = y[j].val(); k < y[j].val() + h[j]; k++) {
-							  GECODE_ME_CHECK(y[i].nq(home, k));
-						  }
-					  }
-					  if (y[i].assigned() && y[i].val() >= y[j].val() && y[i].val() < y[j].val() + h[j]) {
-						  //y are colliding, prune x
-						  for (int k = x[j].val(); k < x[j].val() + w[j]; k++) {
-							  GECODE_ME_CHECK(x[i].nq(home, k));
-						  }
+	  bool changed;
+	  do {
+		  // Pruning below can assign further coordinates, their advisors push them 
+		  // onto the stack as well, so the loop only ends at the fixpoint
+		  while (n_pending > 0) {
+			  int e = pending[--n_pending];
+			  int i = e >> 1;
+			  if ((e & 1) == 0) {
+				  // x[i] got assigned, check it against the fixed rectangles in its columns
+				  done[i] |= 1;
+				  GECODE_ES_CHECK(prune(home, i, x, w, wmax, fx, n_fixed, y, h));
+			  } else {
+				  // y[i] got assigned, check it against the fixed rectangles in its rows
+				  done[i] |= 2;
+				  GECODE_ES_CHECK(prune(home, i, y, h, hmax, fy, n_fixed, x, w));
+			  }
+			  if (done[i] == 3) {
+				  // Rectangle i is now fixed, check all others against it
+				  for (int j = 0; j < x.size(); j++) {
+					  if (j != i && done[j] != 3) {
+						  if (x[j].assigned())
+							  GECODE_ES_CHECK(pruneY(home, j, i));
+						  if (y[j].assigned())
+							  GECODE_ES_CHECK(pruneX(home, j, i));
 					  }
 				  }
+				  insert(x, fx, n_fixed, i);
+				  insert(y, fy, n_fixed, i);
+				  n_fixed++;
 			  }
 		  }
-	  }
+		  // Push the bounds over the compulsory parts of the other rectangles
+		  changed = false;
+		  if (bnd && (n_fixed < x.size())) {
+			  GECODE_ES_CHECK(sweep(home, changed, x, w, y, h));
+			  GECODE_ES_CHECK(sweep(home, changed, y, h, x, w));
+		  }
+	  } while (changed || (n_pending > 0));
 
 	  // Since our propagator checks that they are not colliding, 
-	  // we only need to check that they are all assigned to be sure that the propagator is subsumed
-	  if (x.assigned() && y.assigned())
+	  // we only need to check that they are all fixed to be sure that the propagator is subsumed
+	  if (n_fixed == x.size())
 		  return home.ES_SUBSUMED(*this);
 	  
 	  else
 		  return ES_FIX;
 
 	  /* COMMENTS:
-		This propagator was subscribed to being called everytime the bounds of any of the variables domain is changed.
-		We think that there will be useless calls to the propagator, since we propagate only when values are assigned.
-		We would recommend to change the subscription to PC_INT_VAL.
+		The propagator only acts on assigned coordinates, so instead of subscribing with PC_INT_BND 
+		every coordinate has an advisor which records it once it is assigned (and is then disposed).
+		Each assigned coordinate is only checked against the rectangles fixed so far, and each newly 
+		fixed rectangle only against the others, so the work per run is linear in the number of changes 
+		rather than quadratic in the number of rectangles.
+
+		The fixed rectangles are kept in two lists sorted by x and by y. An assigned coordinate only 
+		looks at the fixed rectangles starting at most one maximal width (height) before it, and the 
+		lines they cover are removed with one range operation instead of value by value.
+
+		With the bounds level the propagator also reasons on compulsory parts: the area between the latest 
+		start and the earliest end of a rectangle in both dimensions, which it covers wherever it is placed. 
+		The interval branching creates exactly these parts, and failures are detected long before 
+		the rectangles are fixed.
 	  */
 
   }
 
   // Dispose propagator and return its size
   virtual size_t dispose(Space& home) {
-    x.cancel(home,*this,PC_INT_BND);
-    y.cancel(home,*this,PC_INT_BND);
+    for (Advisors<ViewAdvisor> as(c); as(); ++as) {
+      ViewAdvisor& a = as.advisor();
+      if (a.isY)
+        y[a.i].cancel(home,a);
+      else
+        x[a.i].cancel(home,a);
+    }
+    c.dispose(home);
+    home.ignore(*this,AP_DISPOSE);
+    w.~IntSharedArray();
+    h.~IntSharedArray();
     (void) Propagator::dispose(home);
     return sizeof(*this);
   }
@@ -152,7 +448,8 @@ public:
  */
 void nooverlap(Home home, 
                const IntVarArgs& x, const IntArgs& w,
-               const IntVarArgs& y, const IntArgs& h) {
+               const IntVarArgs& y, const IntArgs& h,
+               IntPropLevel ipl=IPL_DEF) {
   // Check whether the arguments make sense
   if ((x.size() != y.size()) || (x.size() != w.size()) ||
       (y.size() != h.size()))
@@ -162,14 +459,13 @@ void nooverlap(Home home,
   // Set up array of views for the coordinates
   ViewArray<IntView> vx(home,x);
   ViewArray<IntView> vy(home,y);
-  // Set up arrays (allocated in home) for width and height and initialize
-  int* wc = static_cast<Space&>(home).alloc<int>(x.size());
-  int* hc = static_cast<Space&>(home).alloc<int>(y.size());
-  for (int i=x.size(); i--; ) {
-    wc[i]=w[i]; hc[i]=h[i];
-  }
+  // Set up shared arrays for width and height, clones only copy the reference
+  IntSharedArray wc(w);
+  IntSharedArray hc(h);
+  // Compulsory parts are propagated for bounds and domain propagation
+  bool bnd = (vbd(ipl) == IPL_BND) || (vbd(ipl) == IPL_DOM);
   // If posting failed, fail space
-  if (NoOverlap::post(home,vx,wc,vy,hc) != ES_OK)
+  if (NoOverlap::post(home,vx,wc,vy,hc,bnd) != ES_OK)
     home.fail();
 }
 
@@ -6,33 +6,104 @@
 #include <gecode/driver.hh>
 #include <gecode/int.hh>
 #include <gecode/minimodel.hh>
+#include <gecode/search.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "no-overlap.cpp"
+#include "capacity.cpp"
+#include "../interval/interval.cpp"
 
 using namespace Gecode;
+// Largest forbidden gap to the border for the square sizes 2, 3, ..., 46 (known from the literature)
 static const int forbiddenGaps[] = { 2,3,2,3,3,3,3,4,4,4,5,5,5,5,5,5,6,6,6,6,7,7,7,7,7,7,7,7,8,8,8,8,8,9,9,9,9,9,9,9,9,9,9,9,10 };
+static const int knownGaps = sizeof(forbiddenGaps) / sizeof(int);
+
+// Largest forbidden gap to the border for a square of size k >= 2
+static int forbiddenGap(int k) {
+	if (k - 2 < knownGaps)
+		return forbiddenGaps[k - 2];
+	// Beyond the table only a gap that no square of the model fits into (the 1x1 square is not placed)
+	return 1;
+}
+
+// Options for the square packing
+class SquareOptions : public SizeOptions {
+protected:
+	Driver::BoolOption _split; // Whether to solve the decision problems for s in parallel
+	Driver::DoubleOption _obligatory; // Percentage of the width forced as obligatory part by interval branching
+	Driver::StringOption _order; // Which square the interval branching splits next
+public:
+	SquareOptions(const char* s) : SizeOptions(s),
+		_split("split", "solve the decision problems for each s in parallel", false),
+		_obligatory("obligatory", "percentage of the width forced as obligatory part by interval branching", 0.3),
+		_order("order", "which square the interval branching splits next", IVS_NONE) {
+		_order.add(IVS_NONE, "none", "largest square first (given order)");
+		_order.add(IVS_WIDTH_MAX, "width", "largest width first");
+		_order.add(IVS_RATIO_MIN, "ratio", "smallest ratio of domain size to width first");
+		_order.add(IVS_AFC_MAX, "afc", "largest accumulated failure count (weighted by width) first");
+		add(_split);
+		add(_obligatory);
+		add(_order);
+	}
+	bool split(void) const {
+		return _split.value();
+	}
+	double obligatory(void) const {
+		return _obligatory.value();
+	}
+	IntervalVarSel order(void) const {
+		return static_cast<IntervalVarSel>(_order.value());
+	}
+};
 
 class Square : public Script {
 public:
+	const int n; // Number of squares, taken from the size option
+	const int sMax; // Sum of all widths, if every square were to be placed in a row
 	IntVar s;
 	IntVarArray x, y; 
-	static const int n = 10;
-	static const int sMax = (n * (n + 1)) / 2; // Sum of all widths, if every square were to be placed in a row
-	
-	Square(const SizeOptions& opt) :
+	// Model for non-overlapping squares
+	enum {
+		PROP_REIFIED,  // Reified pairwise constraints
+		PROP_NOOVERLAP // The no-overlap propagator
+	};
+	// Branching on the coordinates
+	enum {
+		BRANCH_MIN,      // Smallest value first
+		BRANCH_INTERVAL, // Interval branching into two subintervals, then smallest value
+		BRANCH_KWAY,     // Interval branching into all subintervals, then smallest value
+		BRANCH_ADAPTIVE  // Interval branching into evened out subintervals, then smallest value
+	};
+	Square(const SquareOptions& opt) :
 		Script(opt), 
+		n(opt.size()),
+		sMax((n * (n + 1)) / 2),
 		s(*this, 2 * n - 1, sMax), // Lower bound: the 2 greatest squares needs to be next to each other
 		x(*this, n-1, 0, sMax - 1), // Don't place the 1x1 square
 		y(*this, n-1, 0, sMax - 1) {
 
+		IntArgs sizes(n - 1);
+		for (int i = 0; i < n - 1; i++)
+			sizes[i] = sizeOfSquare(i);
+
 		// Total area constraint
 		rel(*this, s*s >= n*(n+1)*((2*n)+1)/6);
 
 		// Symmetry removal
-		rel(*this, x[0] <= (s-n)/2); 
-		rel(*this, y[0] <= x[0]);
+		if (n > 1) {
+			rel(*this, x[0] <= (s-n)/2); 
+			rel(*this, y[0] <= x[0]);
+		}
 
 		// Initial domain reduction, forbidden gaps, only applied to 2 sides of the enclosing square
 		for (int i = n - 2; i >= 0; i--) {
-			for (int j = 1; j <= forbiddenGaps[n - i - 2]; j++) {
+			for (int j = 1; j <= forbiddenGap(sizeOfSquare(i)); j++) {
 				rel(*this, x[i] != j);
 				rel(*this, y[i] != j);
 			}
@@ -44,44 +115,55 @@ public:
 			rel(*this, y[i] <= s - sizeOfSquare(i));
 		}
 		
-		// Iterates over each pair once
-		for (int i = 0; i < n-2; i++) {
-			for (int j = i+1; j < n-1; j++) { 
-				rel(*this,  // Reified constraints, checking collision
-					x[i] + sizeOfSquare(i) <= x[j] || // square i left of square j
-					x[j] + sizeOfSquare(j) <= x[i] || // j left of i
-					y[i] + sizeOfSquare(i) <= y[j] || // j above i
-					y[j] + sizeOfSquare(j) <= y[i] // i above j
-				); 
+		switch (opt.propagation()) {
+		case PROP_REIFIED:
+			// Iterates over each pair once
+			for (int i = 0; i < n-2; i++) {
+				for (int j = i+1; j < n-1; j++) { 
+					rel(*this,  // Reified constraints, checking collision
+						x[i] + sizeOfSquare(i) <= x[j] || // square i left of square j
+						x[j] + sizeOfSquare(j) <= x[i] || // j left of i
+						y[i] + sizeOfSquare(i) <= y[j] || // j above i
+						y[j] + sizeOfSquare(j) <= y[i] // i above j
+					); 
+				}
 			}
+			break;
+		case PROP_NOOVERLAP:
+			nooverlap(*this, x, sizes, y, sizes, opt.ipl());
+			break;
 		}
 		
-		for (int i = 0; i < s.max(); i++) { // Looping through each column
-			BoolVarArgs belongsToCol(*this, n - 1, 0, 1); // Booleans for reification
-
-			for (int j = 0; j < n - 1; j++) {
-				dom(*this, x[j], i - sizeOfSquare(j) + 1, i, belongsToCol[j]); // Check for "collision" between column and square
-			}
-			linear(*this, belongsToCol, IRT_LQ, s); // Total square width over row can not exceed enclosing squares width
-		}
-
-		for (int i = 0; i < s.max(); i++) { // Same as for the columns
-			BoolVarArgs belongsToRow(*this, n - 1, 0, 1);
-
-			for (int j = 0; j < n - 1; j++) {
-				dom(*this, y[j], i - sizeOfSquare(j) + 1, i, belongsToRow[j]);
-			}
-			linear(*this, belongsToRow, IRT_LQ, s);
-		}
+		// Total square size crossing a column (row) can not exceed enclosing squares size,
+		// one propagator per axis instead of a reified decomposition per column and row
+		capacity(*this, x, sizes, s);
+		capacity(*this, y, sizes, s);
 		
 		// choosing s as min => optimal solution
 		branch(*this, s, INT_VAL_MIN()); 
+		switch (opt.branching()) {
+		case BRANCH_MIN:
+			break;
+		case BRANCH_INTERVAL:
+			// Obligatory parts first (pays off with the bounds level of the no-overlap propagator)
+			interval(*this, x, sizes, opt.obligatory(), IS_BINARY, opt.order());
+			interval(*this, y, sizes, opt.obligatory(), IS_BINARY, opt.order());
+			break;
+		case BRANCH_KWAY:
+			interval(*this, x, sizes, opt.obligatory(), IS_KWAY, opt.order());
+			interval(*this, y, sizes, opt.obligatory(), IS_KWAY, opt.order());
+			break;
+		case BRANCH_ADAPTIVE:
+			interval(*this, x, sizes, opt.obligatory(), IS_ADAPTIVE, opt.order());
+			interval(*this, y, sizes, opt.obligatory(), IS_ADAPTIVE, opt.order());
+			break;
+		}
 		branch(*this, x, INT_VAR_NONE(), INT_VAL_MIN()); // INT_VAR_NONE => go in order => greatest square first
 		branch(*this, y, INT_VAR_NONE(), INT_VAL_MIN()); // INT_VAL_MIN => Try leftmost/topmost (lowest coordinates) first
 
 	}
 
-	Square(Square& sq) : Script(sq) {
+	Square(Square& sq) : Script(sq), n(sq.n), sMax(sq.sMax) {
 		s.update(*this, sq.s);
 		x.update(*this, sq.x);
 		y.update(*this, sq.y);
@@ -119,17 +201,163 @@ public:
 		return 0;
 	}
 	
-	static int sizeOfSquare(int i) {
+	int sizeOfSquare(int i) const {
 		return n - i;
 	}
 
+	// Bytes a clone of this space does not copy: the arrays shared by its propagators and branchers
+	size_t shared(void) {
+		size_t b = 0;
+		for (Space::Propagators p(*this); p(); ++p) {
+			if (const NoOverlap* no = dynamic_cast<const NoOverlap*>(&p.propagator()))
+				b += no->shared();
+			else if (const Capacity* c = dynamic_cast<const Capacity*>(&p.propagator()))
+				b += c->shared();
+		}
+		for (Space::Branchers q(*this); q(); ++q)
+			if (const IntervalBrancher* ib = dynamic_cast<const IntervalBrancher*>(&q.brancher()))
+				b += ib->shared();
+		return b;
+	}
+
+	// Smallest s not excluded by the posted bounds: the two largest squares side by side and the total area
+	static int lowerBound(int n) {
+		int area = n * (n + 1) * (2 * n + 1) / 6;
+		int s = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(area))));
+		return std::max(s, 2 * n - 1);
+	}
+
+};
+
+/*
+ * Parallel search on s: every value of s between the area bound and sMax is an independent
+ * decision problem. Workers take the smallest open value, a problem is cancelled as soon as a
+ * smaller s is proven feasible or a larger s is proven infeasible (then it is infeasible as well).
+ */
+class SplitSearch {
+public:
+	const SquareOptions& opt;
+	std::mutex m;
+	int next; // Next value of s to hand out
+	std::atomic<int> feasible; // Smallest s proven feasible
+	std::atomic<int> infeasible; // Largest s proven infeasible
+	Square* best; // Solution for the smallest feasible s
+	Search::Statistics stat; // Statistics summed over all decision problems
+	int solved, cancelled;
+
+	SplitSearch(const SquareOptions& o, int lo, int hi) 
+		: opt(o), next(lo), feasible(hi + 1), infeasible(lo - 1), best(NULL), solved(0), cancelled(0) {}
+
+	// Stop object for a single decision problem
+	class Useless : public Search::Stop {
+	protected:
+		const SplitSearch& ss;
+		int v;
+	public:
+		Useless(const SplitSearch& ss0, int v0) : ss(ss0), v(v0) {}
+		virtual bool stop(const Search::Statistics&, const Search::Options&) {
+			return (v >= ss.feasible) || (v <= ss.infeasible);
+		}
+	};
+
+	// Solve decision problems until the optimal s is known
+	void work(void) {
+		while (true) {
+			int v;
+			{
+				std::lock_guard<std::mutex> l(m);
+				v = std::max(next, infeasible + 1);
+				if (v >= feasible)
+					return;
+				next = v + 1;
+			}
+			Square* sq = new Square(opt);
+			rel(*sq, sq->s == v);
+			Useless u(*this, v);
+			Search::Options so;
+			so.threads = 1;
+			so.clone = false;
+			so.stop = &u;
+			DFS<Square> e(sq, so);
+			Square* sol = e.next();
+			std::lock_guard<std::mutex> l(m);
+			stat += e.statistics();
+			if (sol != NULL) {
+				solved++;
+				if (v < feasible) {
+					feasible = v;
+					delete best;
+					best = sol;
+				} else {
+					delete sol;
+				}
+			} else if (e.stopped()) {
+				cancelled++;
+			} else {
+				solved++;
+				if (v > infeasible)
+					infeasible = v;
+			}
+		}
+	}
+
+	// Run the workers and print the result, shared is what a clone does not copy
+	void run(size_t shared) {
+		// As many workers as the driver would use threads (fractions and negative values are relative to the cores)
+		Search::Options so;
+		so.threads = opt.threads();
+		unsigned int n_workers = std::max(static_cast<unsigned int>(so.expand().threads), 1U);
+		Support::Timer t;
+		t.start();
+		std::vector<std::thread> workers;
+		for (unsigned int i = 0; i < n_workers; i++)
+			workers.push_back(std::thread(&SplitSearch::work, this));
+		for (unsigned int i = 0; i < n_workers; i++)
+			workers[i].join();
+		double time = t.stop();
+		if (best != NULL)
+			best->print(std::cout);
+		else
+			std::cout << "No solution" << std::endl;
+		std::cout << std::endl << "Summary" << std::endl
+			<< "\truntime:      " << time << " ms" << std::endl
+			<< "\tworkers:      " << n_workers << std::endl
+			<< "\tdecisions:    " << solved << " solved, " << cancelled << " cancelled" << std::endl
+			<< "\tpropagations: " << stat.propagate << std::endl
+			<< "\tnodes:        " << stat.node << std::endl
+			<< "\tfailures:     " << stat.fail << std::endl
+			<< "\tshared data:  " << shared << " bytes per clone" << std::endl;
+		delete best;
+		best = NULL;
+	}
 };
 
 int main(int argc, char* argv[]) {
-	SizeOptions opt("Square");
-	//opt.size(3);
+	SquareOptions opt("Square");
+	opt.size(10);
+	opt.propagation(Square::PROP_REIFIED);
+	opt.propagation(Square::PROP_REIFIED, "reified", "reified pairwise non-overlap constraints");
+	opt.propagation(Square::PROP_NOOVERLAP, "nooverlap", "no-overlap propagator");
+	opt.branching(Square::BRANCH_MIN);
+	opt.branching(Square::BRANCH_MIN, "min", "smallest coordinate first");
+	opt.branching(Square::BRANCH_INTERVAL, "interval", "binary interval branching first");
+	opt.branching(Square::BRANCH_KWAY, "kway", "k-way interval branching first");
+	opt.branching(Square::BRANCH_ADAPTIVE, "adaptive", "adaptive k-way interval branching first");
 	opt.parse(argc, argv);
-	Script::run<Square, DFS, SizeOptions>(opt);
+	// Measured on the propagated root, the space the search starts cloning from
+	Square* root = new Square(opt);
+	(void) root->status();
+	size_t shared = root->shared();
+	delete root;
+	if (opt.split()) {
+		int n = opt.size();
+		SplitSearch ss(opt, Square::lowerBound(n), (n * (n + 1)) / 2);
+		ss.run(shared);
+	} else {
+		Script::run<Square, DFS, SquareOptions>(opt);
+		// The driver has no hook for its summary, the line follows right after it
+		std::cout << "\tshared data:  " << shared << " bytes per clone" << std::endl;
+	}
 	return 0;
 }
 
@@ -149,6 +377,10 @@ Branching:
 	to place it furthest to the left first. Then we branch on y, and branch on the greatest square first, trying
 	to place it at the top (lowest coordinate).
 
+	With -split the values of s are not tried one after the other: each s is an independent decision
+	problem, so the infeasibility proofs below the optimum run in parallel on -threads workers
+	(0 for all cores). A problem is cancelled as soon as it can no longer change the result.
+
 
 	PRINTOUT:
 
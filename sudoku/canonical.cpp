@@ -0,0 +1,184 @@
+/*
+ * Canonical form of a Sudoku puzzle under the symmetries that keep a grid valid:
+ * transposing, permuting the bands (groups of order rows), the rows within a band,
+ * the stacks (groups of order columns), the columns within a stack, and relabeling
+ * the digits. Two puzzles have the same canonical form if and only if one can be
+ * transformed into the other.
+ *
+ * The canonical form is the lexicographically smallest grid, row by row, over all
+ * transformations, where the digits are relabeled 1, 2, ... in the order in which
+ * they first appear and an empty cell is 0. It is built cell by cell, only keeping
+ * the partial transformations (candidates) that give the smallest prefix. Highly
+ * symmetric puzzles (the empty grid, say) keep too many candidates, then there is
+ * no canonical form.
+ *
+ * Grids are vectors of digits, row by row, 0 for an empty cell.
+ */
+
+#include <vector>
+
+class Canonical {
+protected:
+	// A partial transformation
+	class Candidate {
+	public:
+		bool transposed;
+		std::vector<int> rows; // Output row r is original row rows[r]
+		std::vector<int> cols; // Output column c is original column cols[c]
+		std::vector<int> label; // Canonical digit of every original digit, 0 if not yet seen
+		int next; // Next canonical digit
+	};
+	int order, n;
+	std::vector<int> grid; // The puzzle
+	Candidate best; // A transformation giving the canonical form
+
+	// The digit of the puzzle in output cell (r,c) under candidate k
+	int at(const Candidate& k, int r, int c) const {
+		return k.transposed ? grid[k.cols[c] * n + k.rows[r]] : grid[k.rows[r] * n + k.cols[c]];
+	}
+	// The canonical digit of d under candidate k, labeling d if it is new
+	static int relabel(Candidate& k, int d) {
+		if (d == 0)
+			return 0;
+		if (k.label[d] == 0)
+			k.label[d] = k.next++;
+		return k.label[d];
+	}
+	// The lines (rows or columns) that can follow the lines in used: the next one in the
+	// same group or, at the start of a group, any line of a group not used yet
+	void allowed(const std::vector<int>& used, std::vector<int>& lines) const {
+		lines.clear();
+		int p = static_cast<int>(used.size());
+		for (int l = 0; l < n; l++) {
+			bool free = true;
+			for (int i = 0; i < p; i++) {
+				// At the start of a group the group of l must be new, otherwise l itself
+				if (((p % order == 0) && (used[i] / order == l / order)) || (used[i] == l))
+					free = false;
+			}
+			if (free && ((p % order == 0) || (l / order == used[p - p % order] / order)))
+				lines.push_back(l);
+		}
+	}
+
+public:
+	Canonical(int o) : order(o), n(o * o) {}
+
+	/*
+	 * Compute the canonical form of puzzle into form, giving up (and returning false) if
+	 * more than limit candidates are needed.
+	 */
+	bool compute(const std::vector<int>& puzzle, std::vector<int>& form, size_t limit) {
+		grid = puzzle;
+		form.assign(n * n, 0);
+		std::vector<Candidate> cands, ext;
+		std::vector<int> lines;
+		for (int t = 0; t < 2; t++) {
+			Candidate k;
+			k.transposed = (t == 1);
+			k.label.assign(n + 1, 0);
+			k.next = 1;
+			allowed(k.rows, lines);
+			for (size_t l = 0; l < lines.size(); l++) {
+				k.rows.assign(1, lines[l]);
+				cands.push_back(k);
+			}
+		}
+		// The first row decides the columns, cell by cell
+		for (int c = 0; c < n; c++) {
+			ext.clear();
+			int min = n + 1;
+			for (size_t i = 0; i < cands.size(); i++) {
+				Candidate& k = cands[i];
+				allowed(k.cols, lines);
+				for (size_t l = 0; l < lines.size(); l++) {
+					k.cols.push_back(lines[l]);
+					int d = at(k, 0, c);
+					// The label d would get, only extend the candidate if it can be the smallest
+					int v = (d == 0) ? 0 : ((k.label[d] == 0) ? k.next : k.label[d]);
+					if (v < min) {
+						ext.clear();
+						min = v;
+					}
+					if (v == min) {
+						ext.push_back(k);
+						(void) relabel(ext.back(), d);
+					}
+					k.cols.pop_back();
+				}
+			}
+			if (ext.size() > limit)
+				return false;
+			form[c] = min;
+			cands.swap(ext);
+		}
+		// The other rows, a complete row at a time
+		std::vector<int> row(n), minRow(n), label;
+		for (int r = 1; r < n; r++) {
+			ext.clear();
+			for (size_t i = 0; i < cands.size(); i++) {
+				Candidate& k = cands[i];
+				allowed(k.rows, lines);
+				for (size_t l = 0; l < lines.size(); l++) {
+					k.rows.push_back(lines[l]);
+					// The labels of the row, only extend the candidate if it can be the smallest
+					label = k.label;
+					int next = k.next;
+					for (int c = 0; c < n; c++) {
+						int d = at(k, r, c);
+						if ((d != 0) && (label[d] == 0))
+							label[d] = next++;
+						row[c] = label[d];
+					}
+					if (ext.empty() || (row < minRow)) {
+						ext.clear();
+						minRow = row;
+					}
+					if (row == minRow) {
+						ext.push_back(k);
+						ext.back().label = label;
+						ext.back().next = next;
+					}
+					k.rows.pop_back();
+				}
+			}
+			if (ext.size() > limit)
+				return false;
+			for (int c = 0; c < n; c++)
+				form[r * n + c] = minRow[c];
+			cands.swap(ext);
+		}
+		best = cands[0];
+		// Digits that do not occur in the puzzle get the remaining labels in order
+		for (int d = 1; d <= n; d++) {
+			if (best.label[d] == 0)
+				best.label[d] = best.next++;
+		}
+		return true;
+	}
+
+	// Transform a solution of the puzzle into a solution of the canonical form
+	void toCanonical(const std::vector<int>& solution, std::vector<int>& canonical) const {
+		canonical.resize(n * n);
+		for (int r = 0; r < n; r++) {
+			for (int c = 0; c < n; c++) {
+				int i = best.transposed ? best.cols[c] * n + best.rows[r] : best.rows[r] * n + best.cols[c];
+				canonical[r * n + c] = best.label[solution[i]];
+			}
+		}
+	}
+
+	// Transform a solution of the canonical form back into a solution of the puzzle
+	void fromCanonical(const std::vector<int>& canonical, std::vector<int>& solution) const {
+		std::vector<int> digit(n + 1);
+		for (int d = 1; d <= n; d++)
+			digit[best.label[d]] = d;
+		solution.resize(n * n);
+		for (int r = 0; r < n; r++) {
+			for (int c = 0; c < n; c++) {
+				int i = best.transposed ? best.cols[c] * n + best.rows[r] : best.rows[r] * n + best.cols[c];
+				solution[i] = digit[canonical[r * n + c]];
+			}
+		}
+	}
+};
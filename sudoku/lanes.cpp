@@ -0,0 +1,208 @@
+/*
+ * Bit-parallel engine for 9x9 Sudoku, without Gecode. It keeps several puzzles
+ * side by side in lanes: the candidates of a cell are a 9 bit mask, and the masks
+ * of all lanes for the same cell are stored next to each other, so the propagation
+ * loops over the lanes are straight bitwise operations the compiler can vectorize.
+ *
+ * Propagation (naked and hidden singles) always runs on all lanes together. When a
+ * lane is stuck it guesses the smallest digit of a cell with fewest candidates and
+ * saves the grid without that digit on a small stack of its own. A lane that fails
+ * goes back to its last saved grid. Puzzles that need too many guesses or a deeper
+ * stack are given up, to be solved by the Gecode model instead. A lane that is done
+ * takes the next puzzle right away, so the lanes stay busy.
+ */
+
+#include <string>
+#include <vector>
+
+class LaneSolver {
+public:
+	static const int lanes = 16; // Puzzles propagated together
+	static const int depth = 12; // Stack of saved grids per lane
+	static const int budget = 200; // Guesses per puzzle before it is given up
+	enum Status {
+		LS_SOLVED, // Solved, the solution is in the result
+		LS_FAILED, // No solution
+		LS_GAVEUP // Too hard for the engine
+	};
+	class Result {
+	public:
+		Status status;
+		unsigned int guesses;
+		std::string solution;
+	};
+
+protected:
+	typedef unsigned short int Mask;
+	static const Mask all = 0x1FF;
+	int unit[27][9]; // The cells of the rows, columns and blocks
+	Mask m[81][lanes]; // The candidates of every cell in every lane
+	Mask saved[lanes][depth][81]; // Saved grids of every lane
+	int top[lanes]; // Saved grids in use
+	unsigned int guesses[lanes];
+	int puzzle[lanes]; // Index of the puzzle in the lane, -1 for an idle lane
+
+	// All bits set if x has at most one bit (or none), branch free for the lane loops
+	static Mask single(Mask x) {
+		return static_cast<Mask>(-static_cast<Mask>((x & (x - 1)) == 0));
+	}
+	// All bits set if x is empty
+	static Mask empty(Mask x) {
+		return static_cast<Mask>(-static_cast<Mask>(x == 0));
+	}
+	static int size(Mask x) {
+		int s = 0;
+		for (; x != 0; x &= x - 1)
+			s++;
+		return s;
+	}
+
+	// Propagate all lanes over all units once, a lane that does not change is at its fixpoint
+	void propagate(Mask* changed, Mask* failed) {
+		for (int l = 0; l < lanes; l++)
+			changed[l] = failed[l] = 0;
+		for (int u = 0; u < 27; u++) {
+			Mask fixed[lanes], dup[lanes], once[lanes], twice[lanes];
+			for (int l = 0; l < lanes; l++)
+				fixed[l] = dup[l] = once[l] = twice[l] = 0;
+			// Naked singles: the digits taken, twice is a conflict
+			for (int j = 0; j < 9; j++) {
+				const Mask* x = m[unit[u][j]];
+				for (int l = 0; l < lanes; l++) {
+					Mask s = x[l] & single(x[l]);
+					dup[l] |= fixed[l] & s;
+					fixed[l] |= s;
+				}
+			}
+			// Remove them from the other cells, and count the places of every digit
+			for (int j = 0; j < 9; j++) {
+				Mask* x = m[unit[u][j]];
+				for (int l = 0; l < lanes; l++) {
+					Mask y = x[l] & ~(fixed[l] & ~single(x[l]));
+					changed[l] |= y ^ x[l];
+					x[l] = y;
+					twice[l] |= once[l] & y;
+					once[l] |= y;
+				}
+			}
+			// Hidden singles: a digit with one place goes there, two in one cell is a conflict
+			for (int j = 0; j < 9; j++) {
+				Mask* x = m[unit[u][j]];
+				for (int l = 0; l < lanes; l++) {
+					Mask h = x[l] & once[l] & ~twice[l];
+					Mask y = (h & ~empty(h)) | (x[l] & empty(h));
+					failed[l] |= empty(y) | ~single(h);
+					changed[l] |= y ^ x[l];
+					x[l] = y;
+				}
+			}
+			for (int l = 0; l < lanes; l++)
+				failed[l] |= dup[l] | (once[l] ^ all);
+		}
+	}
+
+	// Load puzzle i (81 characters, 1-9 for a digit) into lane l
+	void load(int l, int i, const char* p) {
+		for (int c = 0; c < 81; c++)
+			m[c][l] = ((p[c] >= '1') && (p[c] <= '9')) ? static_cast<Mask>(1 << (p[c] - '1')) : all;
+		top[l] = 0;
+		guesses[l] = 0;
+		puzzle[l] = i;
+	}
+	// Make lane l idle, all candidates everywhere never change nor fail
+	void idle(int l) {
+		for (int c = 0; c < 81; c++)
+			m[c][l] = all;
+		puzzle[l] = -1;
+	}
+
+public:
+	LaneSolver(void) {
+		for (int i = 0; i < 9; i++) {
+			for (int j = 0; j < 9; j++) {
+				unit[i][j] = i * 9 + j;
+				unit[9 + i][j] = j * 9 + i;
+				unit[18 + i][j] = ((i / 3) * 3 + j / 3) * 9 + (i % 3) * 3 + j % 3;
+			}
+		}
+	}
+
+	// Solve the n puzzles p (each 81 valid characters) into r
+	void solve(const char* const* p, int n, Result* r) {
+		int next = 0;
+		int busy = 0;
+		for (int l = 0; l < lanes; l++) {
+			if (next < n) {
+				load(l, next, p[next]);
+				next++;
+				busy++;
+			} else {
+				idle(l);
+			}
+		}
+		Mask changed[lanes], failed[lanes];
+		while (busy > 0) {
+			propagate(changed, failed);
+			for (int l = 0; l < lanes; l++) {
+				// Lanes still propagating are left alone
+				if ((puzzle[l] < 0) || ((failed[l] == 0) && (changed[l] != 0)))
+					continue;
+				Result& res = r[puzzle[l]];
+				bool done = true;
+				if (failed[l] != 0) {
+					if (top[l] > 0) {
+						// Back to the last saved grid
+						top[l]--;
+						for (int c = 0; c < 81; c++)
+							m[c][l] = saved[l][top[l]][c];
+						done = false;
+					} else {
+						res.status = LS_FAILED;
+					}
+				} else {
+					// A cell with fewest candidates, none if solved
+					int best = -1, min = 10;
+					for (int c = 0; c < 81; c++) {
+						int s = size(m[c][l]);
+						if ((s > 1) && (s < min)) {
+							best = c;
+							min = s;
+						}
+					}
+					if (best < 0) {
+						res.status = LS_SOLVED;
+						res.solution.resize(81);
+						for (int c = 0; c < 81; c++) {
+							int v = 0;
+							while ((m[c][l] >> v) != 1)
+								v++;
+							res.solution[c] = static_cast<char>('1' + v);
+						}
+					} else if ((top[l] == depth) || (guesses[l] == budget)) {
+						res.status = LS_GAVEUP;
+					} else {
+						// Guess the smallest digit, save the grid without it
+						Mask v = m[best][l] & -m[best][l];
+						for (int c = 0; c < 81; c++)
+							saved[l][top[l]][c] = m[c][l];
+						saved[l][top[l]][best] &= ~v;
+						top[l]++;
+						m[best][l] = v;
+						guesses[l]++;
+						done = false;
+					}
+				}
+				if (done) {
+					res.guesses = guesses[l];
+					if (next < n) {
+						load(l, next, p[next]);
+						next++;
+					} else {
+						idle(l);
+						busy--;
+					}
+				}
+			}
+		}
+	}
+};
@@ -2,11 +2,100 @@
 #include <gecode/int.hh>
 #include <gecode/minimodel.hh>
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "units.cpp"
+#include "canonical.cpp"
+#include "lanes.cpp"
+
 using namespace Gecode;
 
+class SudokuOptions : public Options {
+protected:
+	Driver::UnsignedIntOption _order; // Block order, 3 for the usual 9x9 Sudoku
+	Driver::StringValueOption _file; // File with the puzzles to solve in batch
+	Driver::StringValueOption _cache; // File with the solutions of earlier batches
+	Driver::BoolOption _unique; // Whether to check that the solution is unique
+	Driver::UnsignedIntOption _generate; // Number of puzzles to generate
+	Driver::BoolOption _lanes; // Whether to try the bit-parallel engine first
+	Driver::BoolOption _check; // Whether to check the bit-parallel engine against Gecode
+public:
+	SudokuOptions(const char* s) : Options(s),
+		_order("order", "block order (3 for 9x9, 4 for 16x16, ... up to 7)", 3),
+		_file("file", "solve all puzzles in file (- for stdin), one puzzle per line"),
+		_cache("cache", "file with the solutions of earlier batches in canonical form, extended by this batch"),
+		_unique("unique", "check that the solution is unique (search for a second one)", false),
+		_generate("generate", "generate this many puzzles with a unique solution", 0),
+		_lanes("lanes", "solve 9x9 puzzles with the bit-parallel engine first, hard ones with Gecode", false),
+		_check("check", "with -lanes, also solve every puzzle with Gecode and compare", false) {
+		add(_order);
+		add(_file);
+		add(_cache);
+		add(_unique);
+		add(_generate);
+		add(_lanes);
+		add(_check);
+	}
+	int order(void) const {
+		return static_cast<int>(_order.value());
+	}
+	// Parse the options, the digits of a puzzle (1-9, A-Z, a-z) reach up to block order 7
+	void parse(int& argc, char* argv[]) {
+		Options::parse(argc, argv);
+		if ((order() < 1) || (order() > 7)) {
+			std::cerr << "Error: -order must be between 1 and 7" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	const char* file(void) const {
+		return _file.value();
+	}
+	const char* cache(void) const {
+		return _cache.value();
+	}
+	bool unique(void) const {
+		return _unique.value();
+	}
+	unsigned int generate(void) const {
+		return _generate.value();
+	}
+	bool lanes(void) const {
+		return _lanes.value();
+	}
+	bool check(void) const {
+		return _check.value();
+	}
+};
+
 class Sudoku : public Script {
 public:
+	const int order; // Block order
+	const int n; // Size of a unit and number of digits, the grid has n * n cells
 	IntVarArray numbers;
+	enum {
+		PROP_DISTINCT, // One distinct per unit, with the strength from -ipl
+		PROP_UNITS // One propagator for all units, see units.cpp
+	};
 	enum {
 		BRANCH_FIRSTFAIL,
 		BRANCH_MIDDLEVALUE
@@ -224,24 +313,83 @@ public:
 	{ 6,8,7, 3,5,1, 4,9,2 }
 	}*/;
 
-		Sudoku(const Options& opt) : Script(opt), numbers(*this, 81, 1, 9) {
-		for (int i = 0; i <= 8; i++) {
-			distinct(*this, numbers.slice(i * 9, 1, 9), opt.ipl()); // Rows
-			distinct(*this, numbers.slice(i, 9, 9), opt.ipl()); // Columns
-			
-			// The digits defined by the puzzle given
-			for (int j = 0; j < 9; ++j) {
-				if (example[i][j] != 0) {
-					rel(*this, numbers[i * 9 + j] == example[i][j]);
+	// Solve the puzzle in example, or an empty grid if the block order is not 3
+	Sudoku(const SudokuOptions& opt) 
+		: Script(opt), order(opt.order()), n(order * order), numbers(*this, n * n, 1, n) {
+		model(opt);
+		if (order == 3) {
+			for (int i = 0; i < 9; i++) {
+				for (int j = 0; j < 9; j++) {
+					if (example[i][j] != 0) {
+						given(i * 9 + j, example[i][j]);
+					}
 				}
 			}
 		}
+	}
 
-		// Blocks, 3 blocks per row
-		for (int row = 0; row < 9; row += 3) {
-			distinct(*this, numbers.slice(row, 1, 3) + numbers.slice(row + 9, 1, 3) + numbers.slice(row + 18, 1, 3), opt.ipl());
-			distinct(*this, numbers.slice(row + 27, 1, 3) + numbers.slice(row + 27 + 9, 1, 3) + numbers.slice(row + 27 + 18, 1, 3), opt.ipl());
-			distinct(*this, numbers.slice(row + 54, 1, 3) + numbers.slice(row + 54 + 9, 1, 3) + numbers.slice(row + 54 + 18, 1, 3), opt.ipl());
+	// Solve the puzzle given as n * n characters, or only post the model (a prototype) if puzzle is NULL
+	Sudoku(const SudokuOptions& opt, const char* puzzle) 
+		: Script(opt), order(opt.order()), n(order * order), numbers(*this, n * n, 1, n) {
+		model(opt);
+		if (puzzle != NULL)
+			givens(puzzle);
+	}
+
+	/*
+	 * Puzzles are written row by row, one character per cell: 0 or . for an empty cell,
+	 * 1-9 for the digits up to 9, then A-Z and a-z for 10 to 61. So 9x9 puzzles look as 
+	 * usual and 16x16 puzzles use 1-9 and A-G.
+	 */
+	static int digit(char c) {
+		if ((c == '.') || (c == '0'))
+			return 0;
+		if ((c >= '1') && (c <= '9'))
+			return c - '0';
+		if ((c >= 'A') && (c <= 'Z'))
+			return c - 'A' + 10;
+		if ((c >= 'a') && (c <= 'z'))
+			return c - 'a' + 36;
+		return -1;
+	}
+	static char symbol(int v) {
+		if (v <= 9)
+			return static_cast<char>('0' + v);
+		if (v <= 35)
+			return static_cast<char>('A' + v - 10);
+		return static_cast<char>('a' + v - 36);
+	}
+
+	// Whether the first n * n characters of p are a puzzle with digits up to n
+	static bool valid(const char* p, size_t length, int n) {
+		if (length < static_cast<size_t>(n * n))
+			return false;
+		for (int i = 0; i < n * n; i++) {
+			int v = digit(p[i]);
+			if ((v < 0) || (v > n))
+				return false;
+		}
+		return true;
+	}
+
+	// Rows, columns, blocks and the branching
+	void model(const Options& opt) {
+		// The bit masks of units hold at most 49 digits
+		if ((opt.propagation() == PROP_UNITS) && (order <= 7)) {
+			units(*this, numbers);
+		} else {
+			Matrix<IntVarArray> m(numbers, n, n);
+			for (int i = 0; i < n; i++) {
+				distinct(*this, m.row(i), opt.ipl()); // Rows
+				distinct(*this, m.col(i), opt.ipl()); // Columns
+			}
+
+			// Blocks, order blocks per row
+			for (int row = 0; row < n; row += order) {
+				for (int col = 0; col < n; col += order) {
+					distinct(*this, m.slice(col, col + order, row, row + order), opt.ipl());
+				}
+			}
 		}
 
 		
@@ -255,7 +403,22 @@ public:
 		};
 	}
 
-	Sudoku(Sudoku& s) : Script(s) {
+	// The digit defined by the puzzle given for cell i
+	void given(int i, int v) {
+		rel(*this, numbers[i], IRT_EQ, v);
+	}
+
+	// The digits of a puzzle given as n * n characters (see digit)
+	void givens(const char* puzzle) {
+		for (int i = 0; i < n * n; i++) {
+			int v = digit(puzzle[i]);
+			if (v > 0) {
+				given(i, v);
+			}
+		}
+	}
+
+	Sudoku(Sudoku& s) : Script(s), order(s.order), n(s.n) {
 		numbers.update(*this, s.numbers);
 	}
 
@@ -265,22 +428,739 @@ public:
 
 	virtual void print(std::ostream& os) const {
 		os << "Sudoku:" << std::endl;
-		for (int i = 0; i < 9; i++) {
-			for (int j = 0; j < 9; j++) {
-				os << numbers[i * 9 + j] << " ";
+		for (int i = 0; i < n; i++) {
+			for (int j = 0; j < n; j++) {
+				if (numbers[i * n + j].assigned())
+					os << symbol(numbers[i * n + j].val()) << " ";
+				else
+					os << numbers[i * n + j] << " ";
 			}
 			os << std::endl;
 		}
 	}
+
+	// Append the solution as n * n characters (see digit) to s
+	void solution(std::string& s) const {
+		for (int i = 0; i < n * n; i++) {
+			s += symbol(numbers[i].val());
+		}
+	}
 };
 
+// Number of workers for -threads as the driver reads it: 0 for all cores, fractions and
+// negative values relative to the number of cores
+unsigned int workerCount(const Options& opt) {
+	Search::Options so;
+	so.threads = opt.threads();
+	return std::max(static_cast<unsigned int>(so.expand().threads), 1U);
+}
+
+// The model without givens, propagated so that it can be cloned
+Sudoku* prototype(const SudokuOptions& opt) {
+	Sudoku* s = new Sudoku(opt, NULL);
+	(void) s->status();
+	return s;
+}
+
+/*
+ * Solutions of earlier puzzles, shared by all workers. A puzzle is looked up
+ * by its canonical form (see canonical.cpp) and its solution is stored as a
+ * solution of the canonical form, so puzzles that are just transformations
+ * of each other share an entry. Puzzles without canonical form (too many
+ * symmetries) are stored as they are, with = in front of the key.
+ *
+ * The file has one entry per line, the key and the solution separated by a
+ * tab. It is read before the batch and the new entries are appended after.
+ */
+class SolutionCache {
+protected:
+	std::mutex m;
+	std::unordered_map<std::string, std::string> solutions;
+	std::vector<std::string> added; // Keys of the entries not yet in the file
+	size_t bytes; // Size of the keys and solutions
+public:
+	// Candidates for a canonical form before it is given up
+	static const size_t limit = 1 << 14;
+	std::atomic<unsigned long int> lookups, hits, exact;
+
+	SolutionCache(void) : bytes(0), lookups(0), hits(0), exact(0) {}
+
+	// Read the entries from file name, a missing file is an empty cache
+	void load(const char* name) {
+		std::ifstream f(name);
+		std::string line;
+		while (std::getline(f, line)) {
+			size_t tab = line.find('\t');
+			// The solution has one character per cell of the key
+			if ((tab != std::string::npos) && (line.size() - tab - 1 == tab - ((line[0] == '=') ? 1 : 0)))
+				insert(line.substr(0, tab), line.substr(tab + 1), false);
+		}
+	}
+	// Append the new entries to file name, returns false if it can not be written
+	bool save(const char* name) {
+		std::ofstream f(name, std::ios::app);
+		for (size_t i = 0; i < added.size(); i++)
+			f << added[i] << '\t' << solutions[added[i]] << '\n';
+		added.clear();
+		return static_cast<bool>(f);
+	}
+
+	// The key of puzzle, using c for its canonical form
+	void key(Canonical& c, const std::vector<int>& puzzle, std::string& k) {
+		std::vector<int> form;
+		k.clear();
+		if (c.compute(puzzle, form, limit)) {
+			text(form, k);
+		} else {
+			exact++;
+			k = "=";
+			text(puzzle, k);
+		}
+	}
+	static void text(const std::vector<int>& digits, std::string& s) {
+		for (size_t i = 0; i < digits.size(); i++)
+			s += (digits[i] == 0) ? '.' : Sudoku::symbol(digits[i]);
+	}
+
+	bool find(const std::string& k, std::string& solution) {
+		lookups++;
+		std::lock_guard<std::mutex> l(m);
+		std::unordered_map<std::string, std::string>::const_iterator i = solutions.find(k);
+		if (i == solutions.end())
+			return false;
+		hits++;
+		solution = i->second;
+		return true;
+	}
+	// Insert a solution, fresh if it is not yet in the file
+	void insert(const std::string& k, const std::string& solution, bool fresh = true) {
+		std::lock_guard<std::mutex> l(m);
+		if (solutions.insert(std::make_pair(k, solution)).second) {
+			bytes += k.size() + solution.size();
+			if (fresh)
+				added.push_back(k);
+		}
+	}
+
+	size_t entries(void) {
+		std::lock_guard<std::mutex> l(m);
+		return solutions.size();
+	}
+	// Estimated memory: the text, the strings and nodes of the map, and the buckets
+	size_t memory(void) {
+		std::lock_guard<std::mutex> l(m);
+		return bytes + solutions.size() * (2 * sizeof(std::string) + 2 * sizeof(void*)) 
+			+ solutions.bucket_count() * sizeof(void*);
+	}
+};
+
+// The puzzles to solve, mapped into memory if they come from a file
+class PuzzleInput {
+protected:
+	const char* data;
+	size_t size;
+	std::vector<char> buffer; // Used for stdin, which can not be mapped
+#ifdef _WIN32
+	HANDLE file, mapping;
+#else
+	int fd;
+#endif
+public:
+	PuzzleInput(void) : data(NULL), size(0) {
+#ifdef _WIN32
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#else
+		fd = -1;
+#endif
+	}
+
+	// Open name, - for stdin, returns false if it can not be read
+	bool open(const char* name) {
+		if (std::string(name) == "-") {
+			char block[1 << 16];
+			size_t n;
+			while ((n = std::fread(block, 1, sizeof(block), stdin)) > 0)
+				buffer.insert(buffer.end(), block, block + n);
+			data = buffer.data();
+			size = buffer.size();
+			return true;
+		}
+#ifdef _WIN32
+		file = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER length;
+		if (!GetFileSizeEx(file, &length))
+			return false;
+		size = static_cast<size_t>(length.QuadPart);
+		// An empty file can not be mapped
+		if (size == 0)
+			return true;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+			return false;
+		data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		return data != NULL;
+#else
+		fd = ::open(name, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+			return false;
+		size = static_cast<size_t>(st.st_size);
+		if (size == 0)
+			return true;
+		void* m = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (m == MAP_FAILED)
+			return false;
+		madvise(m, size, MADV_SEQUENTIAL);
+		data = static_cast<const char*>(m);
+		return true;
+#endif
+	}
+
+	~PuzzleInput(void) {
+		if (buffer.empty()) {
+#ifdef _WIN32
+			if (data != NULL)
+				UnmapViewOfFile(data);
+			if (mapping != NULL)
+				CloseHandle(mapping);
+			if (file != INVALID_HANDLE_VALUE)
+				CloseHandle(file);
+#else
+			if (data != NULL)
+				munmap(const_cast<char*>(data), size);
+			if (fd >= 0)
+				close(fd);
+#endif
+		}
+	}
+
+	const char* begin(void) const {
+		return data;
+	}
+	const char* end(void) const {
+		return data + size;
+	}
+};
+
+/*
+ * Solves all puzzles of the input on a pool of workers. The puzzles are
+ * handed out in chunks, each chunk is written in input order before the
+ * next one is started, so memory stays bounded for any number of puzzles.
+ * Every puzzle line gives one line of output: the solution (or
+ * "none" or "invalid"), the nodes, the failures and the time in ms.
+ * With -unique the search continues for a second solution, and the
+ * number of solutions found (at most 2) is added after the solution.
+ * With -cache the puzzles are first looked up in the cache, a hit is
+ * mapped back to the puzzle without search (and 0 nodes). The cache
+ * only knows one solution, so it is not used with -unique.
+ * With -lanes the workers take blocks of 9x9 puzzles and solve them with
+ * the bit-parallel engine of lanes.cpp. Only the puzzles it gives up go to
+ * Gecode (and the cache). For the engine the nodes are its guesses, and
+ * the time is the time for the block divided by its puzzles. With -check
+ * every puzzle of the engine is solved with Gecode as well: both must
+ * agree whether there is a solution, and the solution of the engine must
+ * be a solution of the Sudoku model.
+ *
+ * The model is only posted once per worker, into a prototype that is
+ * propagated before any puzzle is seen. Every puzzle is a clone of the
+ * prototype with just its givens posted. Cloning a space updates the
+ * original, so the workers can not share a single prototype.
+ */
+class BatchSolver {
+public:
+	static const size_t chunkSize = 1 << 14;
+	const SudokuOptions& opt;
+	std::vector<const char*> lines; // Start of every line in the current chunk
+	std::vector<size_t> lengths; // Length of every line in the current chunk
+	std::vector<std::string> results; // Output line of every line in the current chunk
+	std::atomic<size_t> next; // Next line of the chunk to hand out
+	std::vector<Sudoku*> prototypes; // Propagated model without givens, one per worker
+	SolutionCache* cache; // Solutions of earlier puzzles, NULL if none
+	std::atomic<unsigned long int> solved, unsolvable, invalid, ambiguous;
+	static const size_t block = 256; // Puzzles per call of the bit-parallel engine
+	std::atomic<unsigned long int> fast, fallback, mismatches;
+	std::mutex m;
+	double laneTime, gecodeTime; // Time for the puzzles of the engine, with the engine and with Gecode
+
+	BatchSolver(const SudokuOptions& o, SolutionCache* c) 
+		: opt(o), next(0), cache(c), solved(0), unsolvable(0), invalid(0), ambiguous(0),
+		  fast(0), fallback(0), mismatches(0), laneTime(0.0), gecodeTime(0.0) {}
+
+	// Whether the bit-parallel engine can be used
+	bool lanes(void) const {
+		return opt.lanes() && (opt.order() == 3) && !opt.unique();
+	}
+
+	~BatchSolver(void) {
+		for (size_t i = 0; i < prototypes.size(); i++)
+			delete prototypes[i];
+	}
+
+	// Solve one puzzle with a clone of prototype and describe the result
+	void solve(const Sudoku& prototype, const char* p, size_t length, std::string& r) {
+		r.clear();
+		if (!Sudoku::valid(p, length, prototype.n)) {
+			invalid++;
+			r = "invalid";
+			return;
+		}
+		Support::Timer t;
+		t.start();
+		int cells = prototype.n * prototype.n;
+		bool cached = (cache != NULL) && !opt.unique();
+		Canonical c(prototype.order);
+		std::vector<int> digits(cells);
+		std::string k;
+		if (cached) {
+			for (int i = 0; i < cells; i++)
+				digits[i] = Sudoku::digit(p[i]);
+			cache->key(c, digits, k);
+			std::string hit;
+			if (cache->find(k, hit)) {
+				for (int i = 0; i < cells; i++)
+					digits[i] = Sudoku::digit(hit[i]);
+				// Solutions of canonical forms are mapped back to the puzzle
+				if (k[0] != '=')
+					c.fromCanonical(std::vector<int>(digits), digits);
+				solved++;
+				r.clear();
+				SolutionCache::text(digits, r);
+				char stats[64];
+				std::snprintf(stats, sizeof(stats), "\t0\t0\t%.3f", t.stop());
+				r += stats;
+				return;
+			}
+		}
+		Sudoku* s = static_cast<Sudoku*>(prototype.clone());
+		s->givens(p);
+		Search::Options so;
+		so.threads = 1;
+		so.clone = false;
+		DFS<Sudoku> e(s, so);
+		Sudoku* sol = e.next();
+		Sudoku* other = ((sol != NULL) && opt.unique()) ? e.next() : NULL;
+		double time = t.stop();
+		if (sol != NULL) {
+			solved++;
+			sol->solution(r);
+			if (cached) {
+				for (int i = 0; i < cells; i++)
+					digits[i] = sol->numbers[i].val();
+				std::vector<int> form;
+				if (k[0] != '=')
+					c.toCanonical(digits, form);
+				std::string v;
+				SolutionCache::text((k[0] != '=') ? form : digits, v);
+				cache->insert(k, v);
+			}
+			delete sol;
+			if (opt.unique())
+				r += (other != NULL) ? "\t2" : "\t1";
+			if (other != NULL) {
+				ambiguous++;
+				delete other;
+			}
+		} else {
+			unsolvable++;
+			r = "none";
+		}
+		char stats[64];
+		Search::Statistics stat = e.statistics();
+		std::snprintf(stats, sizeof(stats), "\t%lu\t%lu\t%.3f", 
+			static_cast<unsigned long int>(stat.node), static_cast<unsigned long int>(stat.fail), time);
+		r += stats;
+	}
+
+	// Solve the lines from b to e with the bit-parallel engine, the puzzles it gives up with Gecode
+	void solveLanes(LaneSolver& ls, const Sudoku& prototype, size_t b, size_t e) {
+		std::vector<const char*> p;
+		std::vector<size_t> index;
+		for (size_t i = b; i < e; i++) {
+			if (Sudoku::valid(lines[i], lengths[i], 9)) {
+				p.push_back(lines[i]);
+				index.push_back(i);
+			} else {
+				invalid++;
+				results[i] = "invalid";
+			}
+		}
+		if (p.empty())
+			return;
+		std::vector<LaneSolver::Result> lr(p.size());
+		Support::Timer t;
+		t.start();
+		ls.solve(p.data(), static_cast<int>(p.size()), lr.data());
+		double time = t.stop();
+		double checkTime = 0.0;
+		size_t gaveUp = 0;
+		for (size_t k = 0; k < p.size(); k++) {
+			std::string& r = results[index[k]];
+			if (lr[k].status == LaneSolver::LS_GAVEUP) {
+				fallback++;
+				gaveUp++;
+				solve(prototype, p[k], 81, r);
+				continue;
+			}
+			fast++;
+			bool sat = (lr[k].status == LaneSolver::LS_SOLVED);
+			if (sat) {
+				solved++;
+				r = lr[k].solution;
+			} else {
+				unsolvable++;
+				r = "none";
+			}
+			char stats[64];
+			std::snprintf(stats, sizeof(stats), "\t%u\t0\t%.3f", lr[k].guesses, time / p.size());
+			r += stats;
+			if (opt.check()) {
+				Support::Timer tc;
+				tc.start();
+				Sudoku* s = static_cast<Sudoku*>(prototype.clone());
+				s->givens(p[k]);
+				Search::Options so;
+				so.threads = 1;
+				so.clone = false;
+				DFS<Sudoku> de(s, so);
+				Sudoku* sol = de.next();
+				checkTime += tc.stop();
+				bool agree = (sol != NULL) == sat;
+				delete sol;
+				if (agree && sat) {
+					// The solution must contain the puzzle and satisfy the model
+					Sudoku* c = static_cast<Sudoku*>(prototype.clone());
+					c->givens(p[k]);
+					c->givens(lr[k].solution.c_str());
+					agree = (c->status() != SS_FAILED);
+					delete c;
+				}
+				if (!agree) {
+					mismatches++;
+					std::cerr << "Mismatch for " << std::string(p[k], 81) << std::endl;
+				}
+			}
+		}
+		if (opt.check()) {
+			std::lock_guard<std::mutex> l(m);
+			// The time of the engine for the puzzles it has not given up
+			laneTime += time * (p.size() - gaveUp) / p.size();
+			gecodeTime += checkTime;
+		}
+	}
+
+	void work(unsigned int w) {
+		size_t i;
+		if (lanes()) {
+			// Too large for the stack of a thread
+			LaneSolver* ls = new LaneSolver;
+			while ((i = next.fetch_add(block)) < lines.size())
+				solveLanes(*ls, *prototypes[w], i, std::min(i + block, lines.size()));
+			delete ls;
+			return;
+		}
+		while ((i = next++) < lines.size())
+			solve(*prototypes[w], lines[i], lengths[i], results[i]);
+	}
+
+	// Solve all puzzles and print the results, returns the number of puzzles
+	unsigned long int run(const PuzzleInput& in) {
+		unsigned int n_workers = workerCount(opt);
+		for (unsigned int i = 0; i < n_workers; i++)
+			prototypes.push_back(prototype(opt));
+		unsigned long int n = 0;
+		const char* p = in.begin();
+		while (p < in.end()) {
+			// Split the next chunk into lines, without copying them
+			lines.clear();
+			lengths.clear();
+			while ((p < in.end()) && (lines.size() < chunkSize)) {
+				const char* q = p;
+				while ((q < in.end()) && (*q != '\n'))
+					q++;
+				size_t length = q - p;
+				if ((length > 0) && (p[length - 1] == '\r'))
+					length--;
+				// Skip empty lines and comments
+				if ((length > 0) && (*p != '#')) {
+					lines.push_back(p);
+					lengths.push_back(length);
+				}
+				p = q + 1;
+			}
+			results.resize(lines.size());
+			next = 0;
+			std::vector<std::thread> workers;
+			for (unsigned int i = 1; i < n_workers; i++)
+				workers.push_back(std::thread(&BatchSolver::work, this, i));
+			work(0);
+			for (unsigned int i = 0; i < workers.size(); i++)
+				workers[i].join();
+			for (size_t i = 0; i < results.size(); i++) {
+				std::fwrite(results[i].data(), 1, results[i].size(), stdout);
+				std::fputc('\n', stdout);
+			}
+			n += static_cast<unsigned long int>(lines.size());
+		}
+		std::fflush(stdout);
+		return n;
+	}
+};
+
+/*
+ * Generates puzzles with a unique solution on a pool of workers. Every
+ * puzzle starts from a random solution, found by assigning the cells in
+ * random order to random values with propagation (and trying another
+ * value after a failure). Then the givens are removed in random order:
+ * a given can go if no solution differs from the random solution in its
+ * cell, that is, if the puzzle without it is still unique.
+ *
+ * The check for the i-th given in the order needs the givens kept so far
+ * and the ones not yet looked at. The kept givens are posted once into a
+ * base space that grows with the puzzle and stays propagated, every check
+ * only clones it and posts the remaining givens and the exclusion.
+ *
+ * Puzzle k is generated from the seed -seed plus k, so the output does
+ * not depend on the number of workers. It is one line per puzzle: the
+ * puzzle, the number of givens, the nodes of all checks and the time in
+ * ms.
+ */
+class Generator {
+public:
+	const SudokuOptions& opt;
+	std::vector<std::string> results; // Output line of every puzzle
+	std::atomic<unsigned int> next; // Next puzzle to generate
+	std::vector<Sudoku*> prototypes; // Propagated model without givens, one per worker
+	std::atomic<unsigned long int> givens; // Givens of all puzzles
+
+	Generator(const SudokuOptions& o) : opt(o), next(0), givens(0) {}
+
+	~Generator(void) {
+		for (size_t i = 0; i < prototypes.size(); i++)
+			delete prototypes[i];
+	}
+
+	// A random solution as a clone of prototype, NULL if the random choices ran into a dead end
+	Sudoku* randomSolution(const Sudoku& prototype, std::mt19937& rnd) {
+		int cells = prototype.n * prototype.n;
+		std::vector<int> order(cells);
+		for (int i = 0; i < cells; i++)
+			order[i] = i;
+		std::shuffle(order.begin(), order.end(), rnd);
+		Sudoku* s = static_cast<Sudoku*>(prototype.clone());
+		for (int k = 0; k < cells; k++) {
+			int i = order[k];
+			while (!s->numbers[i].assigned()) {
+				// A random value from the domain
+				unsigned int pick = std::uniform_int_distribution<unsigned int>(0, s->numbers[i].size() - 1)(rnd);
+				IntVarValues v(s->numbers[i]);
+				while (pick-- > 0)
+					++v;
+				Sudoku* c = static_cast<Sudoku*>(s->clone());
+				c->given(i, v.val());
+				if (c->status() != SS_FAILED) {
+					delete s;
+					s = c;
+				} else {
+					delete c;
+					rel(*s, s->numbers[i], IRT_NQ, v.val());
+					if (s->status() == SS_FAILED) {
+						delete s;
+						return NULL;
+					}
+				}
+			}
+		}
+		return s;
+	}
+
+	// Generate one puzzle from clones of prototype and describe it
+	void generate(const Sudoku& prototype, unsigned int seed, std::string& r) {
+		Support::Timer t;
+		t.start();
+		std::mt19937 rnd(seed);
+		int cells = prototype.n * prototype.n;
+		Sudoku* s;
+		while ((s = randomSolution(prototype, rnd)) == NULL) {}
+		std::vector<int> sol(cells);
+		for (int i = 0; i < cells; i++)
+			sol[i] = s->numbers[i].val();
+		delete s;
+
+		std::vector<int> order(cells);
+		for (int i = 0; i < cells; i++)
+			order[i] = i;
+		std::shuffle(order.begin(), order.end(), rnd);
+		std::vector<bool> kept(cells, true);
+		Search::Statistics stat;
+		// Prototype with the givens kept so far
+		Sudoku* base = static_cast<Sudoku*>(prototype.clone());
+		for (int k = 0; k < cells; k++) {
+			int i = order[k];
+			Sudoku* c = static_cast<Sudoku*>(base->clone());
+			for (int l = k + 1; l < cells; l++)
+				c->given(order[l], sol[order[l]]);
+			rel(*c, c->numbers[i], IRT_NQ, sol[i]);
+			Search::Options so;
+			so.threads = 1;
+			so.clone = false;
+			DFS<Sudoku> e(c, so);
+			Sudoku* other = e.next();
+			stat += e.statistics();
+			if (other == NULL) {
+				kept[i] = false;
+			} else {
+				delete other;
+				base->given(i, sol[i]);
+				(void) base->status();
+			}
+		}
+		delete base;
+		double time = t.stop();
+
+		r.clear();
+		int n_givens = 0;
+		for (int i = 0; i < cells; i++) {
+			if (kept[i]) {
+				r += Sudoku::symbol(sol[i]);
+				n_givens++;
+			} else {
+				r += '.';
+			}
+		}
+		givens += n_givens;
+		char stats[64];
+		std::snprintf(stats, sizeof(stats), "\t%d\t%lu\t%.3f", 
+			n_givens, static_cast<unsigned long int>(stat.node), time);
+		r += stats;
+	}
+
+	void work(unsigned int w) {
+		unsigned int i;
+		while ((i = next++) < results.size())
+			generate(*prototypes[w], opt.seed() + i, results[i]);
+	}
+
+	// Generate the puzzles and print them
+	void run(void) {
+		unsigned int n_workers = workerCount(opt);
+		for (unsigned int i = 0; i < n_workers; i++)
+			prototypes.push_back(prototype(opt));
+		results.resize(opt.generate());
+		std::vector<std::thread> workers;
+		for (unsigned int i = 1; i < n_workers; i++)
+			workers.push_back(std::thread(&Generator::work, this, i));
+		work(0);
+		for (unsigned int i = 0; i < workers.size(); i++)
+			workers[i].join();
+		for (size_t i = 0; i < results.size(); i++) {
+			std::fwrite(results[i].data(), 1, results[i].size(), stdout);
+			std::fputc('\n', stdout);
+		}
+		std::fflush(stdout);
+	}
+};
+
+// Solve the puzzle in example and check with parallel search (-threads) that there is no second solution
+void checkUnique(const SudokuOptions& opt) {
+	Support::Timer t;
+	t.start();
+	Search::Options so;
+	so.threads = opt.threads();
+	DFS<Sudoku> e(new Sudoku(opt), so);
+	Sudoku* sol = e.next();
+	Sudoku* other = (sol != NULL) ? e.next() : NULL;
+	double time = t.stop();
+	if (sol == NULL) {
+		std::cout << "No solution" << std::endl;
+	} else {
+		sol->print(std::cout);
+		if (other != NULL) {
+			std::cout << "Not unique, another solution:" << std::endl;
+			other->print(std::cout);
+		} else {
+			std::cout << "The solution is unique" << std::endl;
+		}
+	}
+	Search::Statistics stat = e.statistics();
+	std::cout << std::endl << "Summary" << std::endl
+		<< "\truntime:      " << time << " ms" << std::endl
+		<< "\tpropagations: " << stat.propagate << std::endl
+		<< "\tnodes:        " << stat.node << std::endl
+		<< "\tfailures:     " << stat.fail << std::endl;
+	delete sol;
+	delete other;
+}
+
 int main(int argc, char* argv[]) {
-	Options opt("Sudoku");
+	SudokuOptions opt("Sudoku");
+	opt.propagation(Sudoku::PROP_UNITS);
+	opt.propagation(Sudoku::PROP_DISTINCT, "distinct", "one distinct per unit (strength from -ipl)");
+	opt.propagation(Sudoku::PROP_UNITS, "units", "one bitset propagator for all units");
 	opt.branching(Sudoku::BRANCH_FIRSTFAIL);
 	opt.branching(Sudoku::BRANCH_FIRSTFAIL, "firstfail", "First fail heuristic");
 	opt.branching(Sudoku::BRANCH_MIDDLEVALUE, "middle", "Select middle value");
 	opt.parse(argc, argv);
-	Script::run<Sudoku, DFS, Options>(opt);
+	if (opt.file() != NULL) {
+		PuzzleInput in;
+		if (!in.open(opt.file())) {
+			std::cerr << "Can not read " << opt.file() << std::endl;
+			return 1;
+		}
+		SolutionCache cache;
+		if (opt.cache() != NULL)
+			cache.load(opt.cache());
+		BatchSolver b(opt, (opt.cache() != NULL) ? &cache : NULL);
+		Support::Timer t;
+		t.start();
+		unsigned long int n = b.run(in);
+		double time = t.stop();
+		if ((opt.cache() != NULL) && !cache.save(opt.cache()))
+			std::cerr << "Can not write " << opt.cache() << std::endl;
+		std::cerr << "Summary" << std::endl
+			<< "\truntime:    " << time << " ms" << std::endl
+			<< "\tpuzzles:    " << n << " (" << b.solved << " solved, " << b.unsolvable 
+			<< " without solution, " << b.invalid << " invalid)" << std::endl;
+		if (opt.unique())
+			std::cerr << "\tambiguous:  " << b.ambiguous << " with more than one solution" << std::endl;
+		if (b.lanes()) {
+			std::cerr << "\tlanes:      " << b.fast << " by the engine, " << b.fallback << " given up to Gecode" << std::endl;
+			if (opt.check())
+				std::cerr << "\tcheck:      " << b.mismatches << " mismatches, " << b.laneTime << " ms with the engine, " 
+					<< b.gecodeTime << " ms with Gecode for the same puzzles" << std::endl;
+		}
+		if ((opt.cache() != NULL) && !opt.unique())
+			std::cerr << "\tcache:      " << cache.hits << " hits in " << cache.lookups << " lookups (" 
+				<< ((cache.lookups > 0) ? 100.0 * cache.hits / cache.lookups : 0.0) << "%), " 
+				<< cache.exact << " without canonical form" << std::endl
+				<< "\t            " << cache.entries() << " entries, " 
+				<< cache.memory() / 1024 << " KB" << std::endl;
+		std::cerr
+			<< "\tthroughput: " << ((time > 0.0) ? n / time * 1000.0 : 0.0) << " puzzles/s" << std::endl;
+		return 0;
+	}
+	if (opt.generate() > 0) {
+		Generator g(opt);
+		Support::Timer t;
+		t.start();
+		g.run();
+		double time = t.stop();
+		std::cerr << "Summary" << std::endl
+			<< "\truntime:    " << time << " ms" << std::endl
+			<< "\tpuzzles:    " << opt.generate() << " (" 
+			<< static_cast<double>(g.givens) / opt.generate() << " givens on average)" << std::endl
+			<< "\tthroughput: " << ((time > 0.0) ? opt.generate() / time * 1000.0 : 0.0) << " puzzles/s" << std::endl;
+		return 0;
+	}
+	if (opt.unique()) {
+		checkUnique(opt);
+		return 0;
+	}
+	Script::run<Sudoku, DFS, SudokuOptions>(opt);
 	return 0;
 }
 
@@ -295,4 +1175,56 @@ int main(int argc, char* argv[]) {
 // IPL_DEF: depth: 16, 311 fails, 311 internal nodes
 // IPL_VAL: same result as IPL_DEF
 // IPL_BND: depth: 7, 12 fails, 12 internal nodes
-// IPL_DOM: depth: 0, 0 fails, 0 internal nodes
\ No newline at end of file
+// IPL_DOM: depth: 0, 0 fails, 0 internal nodes
+// The default is now -propagation units, a single propagator for all 27 units that works on
+// the candidates as bit masks (units.cpp). Naked and hidden singles and pairs solve the puzzle
+// above without search as well, and it is much cheaper than 27 domain consistent distincts. 
+// It is not stronger in general: distinct with IPL_DOM also finds Hall sets larger than two.
+// Use -propagation distinct (with -ipl) for the old model.
+
+/* COMMENTS ABOUT LARGER SUDOKU */
+
+// -order sets the block order: 4 for 16x16, 5 for 25x25 and so on. Without -file only order 3 has
+// a puzzle (example), other orders solve the empty grid. bench-16x16.txt and bench-25x25.txt hold 
+// puzzles with a unique solution to compare the propagation strengths at a larger scale, e.g.
+//   sudoku -order 4 -file bench-16x16.txt -propagation distinct -ipl dom
+//   sudoku -order 4 -file bench-16x16.txt -propagation units
+// Orders above 7 are rejected: a puzzle writes its digits as 1-9, A-Z and a-z, which only
+// reach 61 (order 7 has 49 digits), and units handles the same block orders.
+
+/* COMMENTS ABOUT BATCH SOLVING */
+
+// With -file the puzzles are read from a file (or stdin with -file -), one per line, and 
+// solved with -threads workers. The output has one line per puzzle, in the same order: 
+// the solution, the nodes, the failures and the time in ms, separated by tabs.
+// Lines starting with # and empty lines are skipped.
+// The model is posted once per worker and every puzzle is solved in a clone of it, so the
+// time per puzzle is mostly search: for easy puzzles constructing the 27 distinct 
+// propagators took more time than solving them.
+
+/* COMMENTS ABOUT UNIQUE PUZZLES */
+
+// -unique searches for a second solution: for the example with parallel DFS (-threads), and
+// in batch mode for every puzzle, which adds the number of solutions found (1 or 2) as a column.
+// -generate n writes n new puzzles with a unique solution for the block order from -order, 
+// starting from -seed. The output can be checked again with -file - -unique.
+
+/* COMMENTS ABOUT THE CACHE */
+
+// -cache file keeps the solutions of all batches solved with it, keyed by the canonical form of
+// the puzzle under the symmetries of the grid (canonical.cpp). A puzzle that is a relabeling, a 
+// transposition or a row, column, band or stack permutation of a cached puzzle is answered by 
+// mapping the cached solution back, without search. The canonical form of a 9x9 puzzle takes
+// in the order of a millisecond, more than search for an easy one, so the cache pays off for 
+// hard puzzles and inputs with many duplicates. For 16x16 and larger the canonical form is 
+// mostly given up (too many candidates), these puzzles are only found if they occur verbatim.
+
+/* COMMENTS ABOUT THE BIT-PARALLEL ENGINE */
+
+// -lanes solves 9x9 puzzles in batch mode with lanes.cpp first: 16 puzzles at a time, with naked
+// and hidden singles on bit masks and a small backtracking stack per puzzle. Puzzles that need 
+// more than 200 guesses or 12 nested guesses go to the Gecode model. Add -check to solve all the
+// puzzles of the engine with Gecode too; the summary then has both times for the same puzzles,
+// which is the overhead of the generic engine (cloning, propagator scheduling, branchers).
+// The lane loops only become SIMD code when the compiler vectorizes (e.g. g++ -O3, with 
+// -march=native for AVX2); g++ -O2 keeps them scalar and is several times slower.
\ No newline at end of file
@@ -0,0 +1,246 @@
+/*
+ * Sudoku propagator for all units (rows, columns and blocks) at once.
+ * The candidates of every cell are kept as a bit mask (bit v-1 for the
+ * digit v) in one array, and the units are reduced with bitwise
+ * operations by naked singles, hidden singles, naked pairs and hidden
+ * pairs until nothing changes.
+ *
+ * As with no-overlap.cpp, include (or paste) this file into your model.
+ */
+
+#include <gecode/int.hh>
+
+using namespace Gecode;
+using namespace Gecode::Int;
+
+// The all-units propagator
+class Units : public Propagator {
+protected:
+  typedef Iter::Ranges::Array::Range Range;
+  // A set of digits, or of cells in a unit
+  typedef unsigned long long int Mask;
+  // The cells, row by row
+  ViewArray<IntView> x;
+  // The cells of every unit (array, shared between all clones)
+  IntSharedArray u;
+  // The number of cells in a unit (and of digits)
+  int n;
+  // Whether the mask m has exactly one bit
+  static bool single(Mask m) {
+    return (m != 0) && ((m & (m - 1)) == 0);
+  }
+  // Whether the mask m has exactly two bits
+  static bool pair(Mask m) {
+    return single(m & (m - 1));
+  }
+  // The position of the bit of the single mask m
+  static int bit(Mask m) {
+    int b = 0;
+    while (m >>= 1)
+      b++;
+    return b;
+  }
+  // Restrict the mask of cell c to k, report a change
+  static ExecStatus keep(Mask* m, int c, Mask k, bool& changed) {
+    if ((m[c] & k) != m[c]) {
+      m[c] &= k;
+      if (m[c] == 0)
+        return ES_FAILED;
+      changed = true;
+    }
+    return ES_OK;
+  }
+public:
+  // Create propagator and initialize
+  Units(Home home, ViewArray<IntView>& x0, IntSharedArray& u0, int n0)
+    : Propagator(home), x(x0), u(u0), n(n0) {
+    x.subscribe(home,*this,PC_INT_DOM);
+    // The shared array must be released when the space is deleted
+    home.notice(*this,AP_DISPOSE);
+  }
+  // Post units propagator
+  static ExecStatus post(Home home,
+                         ViewArray<IntView>& x, IntSharedArray& u, int n) {
+    (void) new (home) Units(home,x,u,n);
+    return ES_OK;
+  }
+
+  // Copy constructor during cloning
+  Units(Space& home, Units& p)
+    : Propagator(home,p), u(p.u), n(p.n) {
+    x.update(home,p.x);
+  }
+  // Create copy during cloning
+  virtual Propagator* copy(Space& home) {
+    return new (home) Units(home,*this);
+  }
+
+  // Re-schedule function after propagator has been re-enabled
+  virtual void reschedule(Space& home) {
+    x.reschedule(home,*this,PC_INT_DOM);
+  }
+
+  // Return cost (every pass visits each cell of each unit)
+  virtual PropCost cost(const Space&, const ModEventDelta&) const {
+    return PropCost::linear(PropCost::HI,x.size());
+  }
+
+  /*
+   * Perform propagation: read the candidates into masks, reduce all
+   * units until none changes any more, and write the masks that have
+   * changed back into the cells. As the reductions run to a fixpoint,
+   * the propagator is at its fixpoint afterwards.
+   */
+  virtual ExecStatus propagate(Space& home, const ModEventDelta&) {
+    Region r;
+    const Mask full = (Mask(1) << n) - 1;
+    // Candidates of every cell, before and after propagation
+    Mask* o = r.alloc<Mask>(x.size());
+    Mask* m = r.alloc<Mask>(x.size());
+    for (int i=0; i<x.size(); i++) {
+      Mask k = 0;
+      for (ViewRanges<IntView> vr(x[i]); vr(); ++vr)
+        for (int v=vr.min(); v<=vr.max(); v++)
+          if ((v >= 1) && (v <= n))
+            k |= Mask(1) << (v - 1);
+      if (k == 0)
+        return ES_FAILED;
+      o[i] = m[i] = k;
+    }
+    // The cells (as positions in the unit) where each digit can go
+    Mask* pos = r.alloc<Mask>(n);
+
+    bool changed;
+    do {
+      changed = false;
+      for (int k=0; k<3*n; k++) {
+        const int* c = &u[k*n];
+        // Naked singles: two cells can not take the same digit
+        Mask fixed = 0;
+        for (int j=0; j<n; j++)
+          if (single(m[c[j]])) {
+            if ((fixed & m[c[j]]) != 0)
+              return ES_FAILED;
+            fixed |= m[c[j]];
+          }
+        // Remove the digits taken, and note where each digit can go
+        for (int v=0; v<n; v++)
+          pos[v] = 0;
+        Mask all = 0;
+        for (int j=0; j<n; j++) {
+          if (!single(m[c[j]]))
+            GECODE_ES_CHECK(keep(m,c[j],~fixed,changed));
+          all |= m[c[j]];
+          for (Mask b=m[c[j]]; b != 0; b &= b - 1)
+            pos[bit(b & ~(b - 1))] |= Mask(1) << j;
+        }
+        // Every digit must have a place in the unit
+        if (all != full)
+          return ES_FAILED;
+        // Hidden singles: a digit with a single place goes there
+        for (int v=0; v<n; v++)
+          if (single(pos[v])) {
+            int i = c[bit(pos[v])];
+            // Another hidden single already took the cell
+            if ((m[i] & (Mask(1) << v)) == 0)
+              return ES_FAILED;
+            GECODE_ES_CHECK(keep(m,i,Mask(1) << v,changed));
+          }
+        // Naked pairs: two cells with the same two digits take them
+        for (int j=0; j<n; j++)
+          if (pair(m[c[j]]))
+            for (int l=j+1; l<n; l++)
+              if (m[c[l]] == m[c[j]]) {
+                for (int t=0; t<n; t++)
+                  if ((t != j) && (t != l))
+                    GECODE_ES_CHECK(keep(m,c[t],~m[c[j]],changed));
+                break;
+              }
+        // Hidden pairs: two digits with the same two places take them
+        for (int v=0; v<n; v++)
+          if (pair(pos[v]))
+            for (int w=v+1; w<n; w++)
+              if (pos[w] == pos[v]) {
+                Mask d = (Mask(1) << v) | (Mask(1) << w);
+                for (Mask b=pos[v]; b != 0; b &= b - 1)
+                  GECODE_ES_CHECK(keep(m,c[bit(b & ~(b - 1))],d,changed));
+                break;
+              }
+      }
+    } while (changed);
+
+    // Write back the cells that have changed
+    bool assigned = true;
+    Range* rs = r.alloc<Range>(n);
+    for (int i=0; i<x.size(); i++) {
+      if (!single(m[i]))
+        assigned = false;
+      if (m[i] == o[i])
+        continue;
+      if (single(m[i])) {
+        GECODE_ME_CHECK(x[i].eq(home,bit(m[i]) + 1));
+        continue;
+      }
+      // The digits of the mask as ranges
+      int n_rs = 0;
+      for (int v=0; v<n; ) {
+        if ((m[i] & (Mask(1) << v)) == 0) {
+          v++; continue;
+        }
+        rs[n_rs].min = v + 1;
+        while ((v < n) && ((m[i] & (Mask(1) << v)) != 0))
+          v++;
+        rs[n_rs].max = v;
+        n_rs++;
+      }
+      Iter::Ranges::Array a(rs,n_rs);
+      GECODE_ME_CHECK(x[i].inter_r(home,a,false));
+    }
+    if (assigned)
+      return home.ES_SUBSUMED(*this);
+    return ES_FIX;
+  }
+
+  // Dispose propagator and return its size
+  virtual size_t dispose(Space& home) {
+    x.cancel(home,*this,PC_INT_DOM);
+    home.ignore(*this,AP_DISPOSE);
+    u.~IntSharedArray();
+    (void) Propagator::dispose(home);
+    return sizeof(*this);
+  }
+};
+
+/*
+ * Post the constraint that the cells x of a Sudoku, row by row, take
+ * different digits in every row, column and block. The number of cells
+ * must be the fourth power of the block order (at most 7, so that the
+ * digits and the cells of a unit fit into a mask).
+ */
+void units(Home home, const IntVarArgs& x) {
+  // The block order b and the number of cells n in a unit
+  int b = 1;
+  while (b*b*b*b < x.size())
+    b++;
+  int n = b*b;
+  // Check whether the arguments make sense
+  if ((n*n != x.size()) || (b > 7))
+    throw ArgumentSizeMismatch("units");
+  // Never post a propagator in a failed space
+  if (home.failed()) return;
+  // Set up array of views for the cells
+  ViewArray<IntView> vx(home,x);
+  // The cells of the rows, the columns and the blocks
+  IntArgs c(3*n*n);
+  for (int i=0; i<n; i++)
+    for (int j=0; j<n; j++) {
+      c[i*n + j] = i*n + j;
+      c[(n + i)*n + j] = j*n + i;
+      c[(2*n + i)*n + j] = ((i/b)*b + j/b)*n + (i%b)*b + j%b;
+    }
+  // Set up shared array for the units, clones only copy the reference
+  IntSharedArray u(c);
+  // If posting failed, fail space
+  if (Units::post(home,vx,u,n) != ES_OK)
+    home.fail();
+}